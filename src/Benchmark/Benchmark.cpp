@@ -0,0 +1,89 @@
+#include <chrono>
+#include <iomanip>
+
+#include "Benchmark/Benchmark.h"
+
+/**
+ * \class Benchmark
+ */
+
+Benchmark::Benchmark() :
+	min_time_ms(DEFAULT_MIN_TIME_MS)
+{}
+
+void Benchmark::set_min_time_ms(uint min_time_ms)
+{
+	this->min_time_ms = min_time_ms;
+}
+
+uint Benchmark::get_min_time_ms() const
+{
+	return min_time_ms;
+}
+
+void Benchmark::add(const std::string &name, size_t bytes_per_op, Body body)
+{
+	cases.push_back({name, bytes_per_op, body});
+}
+
+void Benchmark::run()
+{
+	results.clear();
+	for (const Case &c : cases) {
+		results.push_back(run_case(c));
+		std::cerr << ".";
+	}
+	std::cerr << "\n";
+}
+
+void Benchmark::print(std::ostream &out) const
+{
+	out << std::left << std::setw(48) << "benchmark"
+	    << std::right << std::setw(14) << "iterations"
+	    << std::setw(14) << "ns/op"
+	    << std::setw(14) << "MB/s" << "\n";
+
+	for (const Result &r : results) {
+		out << std::left << std::setw(48) << r.name
+		    << std::right << std::setw(14) << r.iterations
+		    << std::setw(14) << std::fixed << std::setprecision(1) << r.ns_per_op
+		    << std::setw(14) << r.bytes_per_second / 1e6 << "\n";
+	}
+}
+
+void Benchmark::print_json(std::ostream &out) const
+{
+	out << "{\n  \"benchmarks\": [";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const Result &r = results[i];
+		out << (i == 0 ? "\n" : ",\n")
+		    << "    {\"name\": \"" << r.name << "\", "
+		    << "\"iterations\": " << r.iterations << ", "
+		    << std::fixed << std::setprecision(3)
+		    << "\"ns_per_op\": " << r.ns_per_op << ", "
+		    << "\"bytes_per_second\": " << r.bytes_per_second << "}";
+	}
+	out << "\n  ]\n}\n";
+}
+
+Benchmark::Result Benchmark::run_case(const Case &c) const
+{
+	typedef std::chrono::steady_clock Clock;
+
+	uint64_t iterations = 1;
+	double elapsed_ns;
+
+	while (true) {
+		Clock::time_point start = Clock::now();
+		c.body(iterations);
+		elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			Clock::now() - start).count();
+
+		if (elapsed_ns >= min_time_ms * 1e6)
+			break;
+		iterations *= 2;
+	}
+
+	double ns_per_op = elapsed_ns / iterations;
+	return {c.name, iterations, ns_per_op, c.bytes_per_op * 1e9 / ns_per_op};
+}
@@ -0,0 +1,64 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * Minimal microbenchmark runner.
+ *
+ * Every case is a function executing its body a given number of times.
+ * The runner doubles the iteration count until a run takes at least
+ * the minimal time and reports the time and throughput of that run.
+ */
+class Benchmark
+{
+public:
+	typedef std::function<void(uint64_t iterations)> Body;
+
+	struct Result {
+		std::string name;
+		uint64_t iterations;
+		double ns_per_op;
+		double bytes_per_second;
+	};
+
+	Benchmark();
+
+	void set_min_time_ms(uint min_time_ms);
+	uint get_min_time_ms() const;
+
+	void add(const std::string &name, size_t bytes_per_op, Body body);
+	void run();
+
+	void print(std::ostream &out) const;
+	void print_json(std::ostream &out) const;
+
+	/** Keeps the compiler from optimizing away a computed value */
+	template <class T>
+	static void do_not_optimize(const T &value)
+	{
+		asm volatile("" : : "r"(&value) : "memory");
+	}
+
+private:
+	struct Case {
+		std::string name;
+		size_t bytes_per_op;
+		Body body;
+	};
+
+	Result run_case(const Case &c) const;
+
+	std::vector<Case> cases;
+	std::vector<Result> results;
+
+	uint min_time_ms;
+
+	static const uint DEFAULT_MIN_TIME_MS = 200;
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,240 @@
+#include <iostream>
+#include <vector>
+
+#include "Benchmark/Benchmark.h"
+#include "Server/ClientObject.h"
+#include "Server/Mixer.h"
+#include "Server/WorkerPool.h"
+#include "System/ArgsManager.h"
+#include "System/Error.h"
+#include "System/Messages.h"
+#include "System/Strings.h"
+#include "System/Utils.h"
+
+static const size_t PAYLOAD_SIZE = EM::Default::TX_INTERVAL * Mixer::DATA_MS_SIZE;
+
+static void add_mixer_benchmarks(Benchmark &benchmark)
+{
+	for (size_t clients : {1, 4, 16, 64, 200}) {
+		for (uint tx_interval : {5, 10, 20}) {
+			size_t length = tx_interval * Mixer::DATA_MS_SIZE;
+			std::string name = "mixer/clients:" + std::to_string(clients)
+				+ "/tx_interval:" + std::to_string(tx_interval);
+
+			benchmark.add(name, clients * length, [clients, tx_interval, length](uint64_t n) {
+				std::vector<char> input_data(clients * length);
+				for (size_t i = 0; i < input_data.size(); ++i)
+					input_data[i] = (char) (i * 7);
+
+				std::vector<Mixer::MixerInput> inputs(clients);
+				for (size_t i = 0; i < clients; ++i)
+					inputs[i] = {&input_data[i * length], length, 0};
+
+				std::vector<char> output(length);
+				size_t output_size;
+
+				for (uint64_t i = 0; i < n; ++i) {
+					Mixer::mixer(inputs.data(), clients, output.data(), &output_size,
+						tx_interval);
+					Benchmark::do_not_optimize(output[0]);
+				}
+			});
+		}
+	}
+}
+
+static void add_parallel_mixer_benchmarks(Benchmark &benchmark)
+{
+	static const size_t CLIENTS = 2000;
+	static const size_t LENGTH  = EM::Default::TX_INTERVAL * Mixer::DATA_MS_SIZE;
+
+	for (size_t workers : {0, 1, 3}) {
+		std::string name = "mixer_parallel/clients:" + std::to_string(CLIENTS)
+			+ "/workers:" + std::to_string(workers);
+
+		benchmark.add(name, CLIENTS * LENGTH, [workers](uint64_t n) {
+			std::vector<char> input_data(CLIENTS * LENGTH);
+			for (size_t i = 0; i < input_data.size(); ++i)
+				input_data[i] = (char) (i * 7);
+
+			std::vector<Mixer::MixerInput> inputs(CLIENTS);
+			for (size_t i = 0; i < CLIENTS; ++i)
+				inputs[i] = {&input_data[i * LENGTH], LENGTH, 0};
+
+			std::vector<char> output(LENGTH);
+			size_t samples = LENGTH / sizeof(EM::data_t);
+
+			WorkerPool pool(workers, [](size_t) {});
+			size_t tasks = pool.get_size();
+			for (uint64_t i = 0; i < n; ++i) {
+				Mixer::consume(inputs.data(), CLIENTS, LENGTH);
+				pool.run(tasks, [&](size_t task) {
+					Mixer::mix_range(inputs.data(), CLIENTS, output.data(),
+						samples * task / tasks, samples * (task + 1) / tasks);
+				});
+				Benchmark::do_not_optimize(output[0]);
+			}
+		});
+	}
+}
+
+static void add_messages_benchmarks(Benchmark &benchmark)
+{
+	const std::string upload = EM::Messages::Headers::Upload + " 123456\n"
+		+ std::string(PAYLOAD_SIZE, 'x');
+	const std::string data = EM::Messages::write_data(123456, 654321, 10560, EM::Default::TX_INTERVAL);
+	const std::string ack  = EM::Messages::write_ack(654321, 10560);
+
+	benchmark.add("messages/get_type/upload", upload.size(), [upload](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			EM::Messages::Type type = EM::Messages::get_type(upload);
+			Benchmark::do_not_optimize(type);
+		}
+	});
+
+	benchmark.add("messages/read_upload", upload.size(), [upload](uint64_t n) {
+		uint nr;
+		for (uint64_t i = 0; i < n; ++i) {
+			bool ok = EM::Messages::read_upload(upload, nr);
+			Benchmark::do_not_optimize(ok);
+		}
+	});
+
+	benchmark.add("messages/read_data", data.size(), [data](uint64_t n) {
+		uint nr, ack;
+		size_t win;
+		for (uint64_t i = 0; i < n; ++i) {
+			bool ok = EM::Messages::read_data(data, nr, ack, win);
+			Benchmark::do_not_optimize(ok);
+		}
+	});
+
+	benchmark.add("messages/read_ack", ack.size(), [ack](uint64_t n) {
+		uint nr;
+		size_t win;
+		for (uint64_t i = 0; i < n; ++i) {
+			bool ok = EM::Messages::read_ack(ack, nr, win);
+			Benchmark::do_not_optimize(ok);
+		}
+	});
+
+	benchmark.add("messages/write_data", data.size(), [](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			std::string header = EM::Messages::write_data(i, i + 1, 10560, EM::Default::TX_INTERVAL);
+			Benchmark::do_not_optimize(header);
+		}
+	});
+
+	benchmark.add("messages/write_ack", ack.size(), [](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			std::string header = EM::Messages::write_ack(i, 10560);
+			Benchmark::do_not_optimize(header);
+		}
+	});
+}
+
+static void add_client_queue_benchmarks(Benchmark &benchmark)
+{
+	const std::string chunk(PAYLOAD_SIZE, 'x');
+
+	benchmark.add("client_queue/insert_get_move", chunk.size(), [chunk](uint64_t n) {
+		ClientQueue queue(EM::Default::FIFO_SIZE, 0, EM::Default::FIFO_SIZE / 2);
+		uint nr = 1;
+		while (queue.get_size() < EM::Default::FIFO_SIZE / 2)
+			queue.insert(chunk, nr++);
+
+		for (uint64_t i = 0; i < n; ++i) {
+			queue.insert(chunk, nr++);
+			std::string data = queue.get(chunk.size());
+			Benchmark::do_not_optimize(data);
+			queue.move(data.size());
+		}
+	});
+
+	benchmark.add("client_queue/insert_rejected_full", chunk.size(), [chunk](uint64_t n) {
+		ClientQueue queue(EM::Default::FIFO_SIZE, 0, EM::Default::FIFO_SIZE);
+		uint nr = 1;
+		while (queue.insert(chunk, nr))
+			++nr;
+
+		for (uint64_t i = 0; i < n; ++i) {
+			bool ok = queue.insert(chunk, nr + i);
+			Benchmark::do_not_optimize(ok);
+		}
+	});
+
+	for (uint tx_interval : {1, 5, 20}) {
+		size_t length = tx_interval * Mixer::DATA_MS_SIZE;
+		std::string name = "client_queue/fill_drain/tx_interval:" + std::to_string(tx_interval);
+
+		benchmark.add(name, EM::Default::FIFO_SIZE, [chunk, length](uint64_t n) {
+			ClientQueue queue(EM::Default::FIFO_SIZE, 0, EM::Default::FIFO_SIZE);
+			uint nr = 1;
+
+			for (uint64_t i = 0; i < n; ++i) {
+				while (queue.insert(chunk, nr))
+					++nr;
+				while (queue.get_size() > 0) {
+					std::string data = queue.get(length);
+					Benchmark::do_not_optimize(data);
+					queue.move(data.size());
+				}
+			}
+		});
+	}
+}
+
+static void add_send_data_benchmarks(Benchmark &benchmark)
+{
+	const std::string data(PAYLOAD_SIZE, 'x');
+
+	benchmark.add("send_data/message", data.size(), [data](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			std::string message = EM::Messages::write_data(i, i + 1, 10560, EM::Default::TX_INTERVAL) + data;
+			Benchmark::do_not_optimize(message);
+		}
+	});
+}
+
+int main(int argc, char **argv)
+{
+	ArgsManager args_manager(argc - 1, argv + 1);
+
+	Benchmark benchmark;
+	bool json = false;
+
+	while (!args_manager.finished()) {
+		switch (args_manager.get_arg()) {
+			case EM::Arg::Help:
+				std::cout << EM::Strings::Benchmark::HelpMessage;
+				return EXIT_SUCCESS;
+
+			case EM::Arg::Json:
+				json = true;
+				break;
+			case EM::Arg::Duration:
+				benchmark.set_min_time_ms(args_manager.get_uint());
+				break;
+
+			default:
+				std::cerr << EM::Errors::to_string(EM::Error::UnknownArg) << ": "
+				          << args_manager.get_previous_arg() << "\n";
+				return EXIT_SUCCESS;
+		}
+	}
+
+	add_mixer_benchmarks(benchmark);
+	add_parallel_mixer_benchmarks(benchmark);
+	add_messages_benchmarks(benchmark);
+	add_client_queue_benchmarks(benchmark);
+	add_send_data_benchmarks(benchmark);
+
+	benchmark.run();
+
+	if (json)
+		benchmark.print_json(std::cout);
+	else
+		benchmark.print(std::cout);
+
+	return EXIT_SUCCESS;
+}
@@ -1,9 +1,14 @@
 #include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <cerrno>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <sys/socket.h>
 #include <thread>
 #include <unistd.h>
+#include <vector>
 
 #include "Client/EMClient.h"
 #include "System/AbstractServer.h"
@@ -15,22 +20,43 @@
  * \class EMClient
  */
 
+const uint EMClient::CONNECTION_EXPIRY_TIME_SEC;
+const uint EMClient::CONNECTION_RETRY_TIME_SEC;
+const uint EMClient::RESUME_TIMEOUT_MS;
+const uint EMClient::RESUME_ATTEMPTS;
+const uint EMClient::RECONNECT_TIME_SEC;
+const uint EMClient::KEEP_ALIVE_TIMEOUT_MS;
+
 EMClient::EMClient(std::istream &in, std::ostream &out) :
 	in(in),
 	out(out),
 	port(EM::Default::PORT),
+	cid(0),
+	token(0),
 	retransmit_limit(EM::Default::RETRANSMIT_LIMIT),
+	sample_rate(EM::Default::SAMPLE_RATE),
+	channels(EM::Default::CHANNELS),
+	output_fd(-1),
+
+	heard(0),
+	reports(0),
+	stale_connection(false),
+	stop_requested(false),
 
 	io_service(),
 	tcp_socket(io_service),
 	tcp_resolver(io_service),
 
 	udp_socket(io_service, boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), 0)),
-	udp_resolver(io_service)
+	udp_resolver(io_service),
+
+	multicast_socket(io_service)
 {}
 
 EMClient::~EMClient()
-{}
+{
+	leave_multicast();
+}
 
 void EMClient::set_port(uint port)
 {
@@ -62,11 +88,41 @@ uint EMClient::get_retransmit_limit() const
 	return retransmit_limit;
 }
 
+void EMClient::set_sample_rate(uint sample_rate)
+{
+	this->sample_rate = sample_rate;
+}
+
+uint EMClient::get_sample_rate() const
+{
+	return sample_rate;
+}
+
+void EMClient::set_channels(uint channels)
+{
+	this->channels = channels;
+}
+
+uint EMClient::get_channels() const
+{
+	return channels;
+}
+
+void EMClient::set_output_fd(int output_fd)
+{
+	this->output_fd = output_fd;
+}
+
+int EMClient::get_output_fd() const
+{
+	return output_fd;
+}
+
 void EMClient::start()
 {
 	io_service.run();
 
-	info() << "Connecting with " << get_server_name() << " on port " << get_port() << "\n";
+	EM_INFO << "Connecting with " << get_server_name() << " on port " << get_port() << "\n";
 
 	boost::system::error_code error;
 	boost::array<char, EM::Messages::LENGTH> buf;
@@ -75,53 +131,68 @@ void EMClient::start()
 
 	boost::asio::deadline_timer timer(io_service);
 
-	while (true) {
+	while (!stop_requested) {
 		repeat_twice {
-			set_connected(connect_tcp());
+			if (stop_requested)
+				return;
+
+			set_connected(connect_tcp(cid, token));
 
 			if (is_connected())
 				std::thread (&EMClient::connect_udp, this).detach();
 			else
 				continue;
 
-			info() << "Connected!\n";
+			EM_INFO << "Connected!\n";
 
 			static const uint MAX_DELAY = 3;
 			uint delay = 0;
 
-			while (is_connected()) {
+			while (is_connected() && !stop_requested) {
 				size_t bytes_read =
 					tcp_socket.read_some(boost::asio::buffer(buf), error);
 
+				if (stop_requested)
+					return;
+
 				if (error) {
 					/** When error is something other than nothing to read */
 					if (error.value() != boost::asio::error::eof ||
-						delay > MAX_DELAY)
-						set_connected(false);
-					else
+						delay > MAX_DELAY || stale_connection.exchange(false)) {
+						if (resume_session())
+							delay = 0;
+						else
+							set_connected(false);
+					} else {
 						++delay;
+					}
 				} else {
 					delay = 0;
+					++reports;
 					received_message =
 						std::string(buf.begin(),
 							buf.begin() + bytes_read);
-					info() << received_message;
+					EM_INFO << received_message;
 				}
 				timer.expires_from_now(
 					boost::posix_time::milliseconds(
 						AbstractServer::SEND_INFO_TIMEOUT_MS));
-				timer.wait();
+				timer.wait(error);
 			}
-			info() << "Disconnected!\n";
+			EM_INFO << "Disconnected!\n";
 		}
 		timer.expires_from_now(
 			boost::posix_time::seconds(CONNECTION_RETRY_TIME_SEC));
-		timer.wait();
+		timer.wait(error);
 	}
 }
 
 void EMClient::quit()
-{}
+{
+	stop_requested = true;
+	/** shutdown(2) is async-signal-safe, unlike anything of asio */
+	::shutdown(tcp_socket.native_handle(), SHUT_RDWR);
+}
 
 bool EMClient::is_connected() const
 {
@@ -145,9 +216,56 @@ void EMClient::touch_connection()
 	timer.async_wait(boost::bind(&EMClient::set_connected, this, false));
 }
 
-bool EMClient::connect_tcp()
+bool EMClient::resume_session()
+{
+	if (token == 0)
+		return false;
+
+	EM_INFO << "Resuming the session...\n";
+
+	/** The new connection comes with a session of its own, the server merges it into ours */
+	uint connection_cid;
+	uint64_t connection_token;
+	if (!connect_tcp(connection_cid, connection_token))
+		return false;
+
+	boost::system::error_code error;
+	boost::asio::deadline_timer timer(io_service);
+	for (uint attempt = 0; attempt < RESUME_ATTEMPTS; ++attempt) {
+		uint64_t before = heard;
+		send_resume(connection_cid, connection_token);
+
+		timer.expires_from_now(boost::posix_time::milliseconds(RESUME_TIMEOUT_MS));
+		timer.wait(error);
+		if (heard != before) {
+			EM_INFO << "Resumed!\n";
+			/** As good as a report, the watchdog starts over */
+			++reports;
+			return true;
+		}
+	}
+
+	EM_INFO << "The server doesn't know the session anymore.\n";
+	return false;
+}
+
+bool EMClient::send_resume(uint connection_cid, uint64_t connection_token)
+{
+	char message[EM::Messages::LENGTH];
+	std::snprintf(message, sizeof(message), EM::Messages::Resume.c_str(), cid,
+		(unsigned long long) token, connection_cid, (unsigned long long) connection_token);
+
+	EM_LOG << "SEND " << message;
+
+	boost::system::error_code error;
+	send_udp(message, std::strlen(message), error);
+
+	return (bool) !error;
+}
+
+bool EMClient::connect_tcp(uint &cid, uint64_t &token)
 {
-	log() << "Establishing connection... ";
+	EM_LOG << "Establishing connection... ";
 
 	boost::system::error_code error;
 
@@ -160,17 +278,17 @@ bool EMClient::connect_tcp()
 	boost::asio::connect(tcp_socket, endpoint_iterator, error);
 
 	if (error)
-		log() << "unable to connect.\n";
+		EM_LOG << "unable to connect.\n";
 
-	return !error && read_init_message();
+	return !error && read_init_message(cid, token);
 }
 
-bool EMClient::read_init_message()
+bool EMClient::read_init_message(uint &cid, uint64_t &token)
 {
 	boost::array<char, EM::Messages::LENGTH> buf;
 	boost::system::error_code error;
 
-	log() << "Reading network initialization message... ";
+	EM_LOG << "Reading network initialization message... ";
 
 	size_t length = tcp_socket.read_some(boost::asio::buffer(buf), error);
 
@@ -178,39 +296,129 @@ bool EMClient::read_init_message()
 		return false;
 
 	std::string received_message(buf.begin(), buf.begin() + length);
+	if (!EM::Messages::read_client(received_message, cid, token))
+		return false;
+
+	/** A multicast group may follow on the next line */
+	boost::asio::ip::udp::endpoint group_endpoint;
+	std::string group;
+	uint group_port;
+	size_t index = received_message.find('\n');
+	if (index != std::string::npos && EM::Messages::read_multicast(
+			received_message.substr(index + 1), group, group_port)) {
+		boost::system::error_code error;
+		boost::asio::ip::address address = boost::asio::ip::address::from_string(group, error);
+		if (!error && address.is_multicast())
+			group_endpoint = boost::asio::ip::udp::endpoint(address, group_port);
+	}
+
+	/** A server without the group, or with another one, ends the membership */
+	if (group_endpoint != multicast_endpoint) {
+		leave_multicast();
+		multicast_endpoint = group_endpoint;
+	}
+
+	return true;
+}
+
+bool EMClient::join_multicast()
+{
+	if (multicast_endpoint.port() == 0)
+		return false;
+	if (multicast_socket.is_open())
+		return true;
+
+	boost::system::error_code error;
+	multicast_socket.open(boost::asio::ip::udp::v4(), error);
+	if (!error)
+		multicast_socket.set_option(boost::asio::ip::udp::socket::reuse_address(true), error);
+	/** Bound to the group, so other traffic to the port stays out */
+	if (!error)
+		multicast_socket.bind(multicast_endpoint, error);
+	if (!error)
+		multicast_socket.set_option(
+			boost::asio::ip::multicast::join_group(multicast_endpoint.address()), error);
+
+	if (error) {
+		EM_WARN << "Unable to join " << multicast_endpoint << ", staying on unicast.\n";
+		multicast_socket.close(error);
+		multicast_endpoint = boost::asio::ip::udp::endpoint();
+		return false;
+	}
+
+	EM_INFO << "Joined " << multicast_endpoint << ".\n";
+	multicast_thread = std::thread(&EMClient::multicast_routine, this);
+	return true;
+}
+
+void EMClient::leave_multicast()
+{
+	if (!multicast_socket.is_open())
+		return;
+
+	boost::system::error_code error;
+	multicast_socket.set_option(
+		boost::asio::ip::multicast::leave_group(multicast_endpoint.address()), error);
+	/** Wakes the receiving thread with an empty read, it ends on it */
+	multicast_socket.shutdown(boost::asio::ip::udp::socket::shutdown_receive, error);
+	if (multicast_thread.joinable())
+		multicast_thread.join();
+	multicast_socket.close(error);
+
+	EM_INFO << "Left " << multicast_endpoint << ".\n";
+}
+
+void EMClient::multicast_routine()
+{
+	boost::system::error_code error;
+	boost::asio::ip::udp::endpoint sender_endpoint;
+	std::vector<char> buf(BUFFER_SIZE);
+
+	while (true) {
+		size_t length = multicast_socket.receive_from(boost::asio::buffer(buf),
+			sender_endpoint, boost::asio::ip::udp::socket::message_flags(0), error);
+		if (error || length == 0)
+			return;
 
-	return EM::Messages::read_client(received_message, cid);
+		if (is_connected())
+			read_data(buf.data(), length, true);
+	}
 }
 
 void EMClient::connect_udp()
 {
-	log() << "Establishing UDP connection...\n";
+	EM_LOG << "Establishing UDP connection...\n";
 
 	std::string request(EM::Messages::LENGTH, '\0');
-	std::sprintf(&request[0], EM::Messages::Client.c_str(), cid);
+	std::sprintf(&request[0], EM::Messages::ClientFormat.c_str(), cid,
+		get_sample_rate(), get_channels(), (uint) join_multicast());
 
 	boost::system::error_code error;
 
 	boost::asio::deadline_timer timer(io_service);
 
 	do {
-		udp_endpoint = *udp_resolver.resolve({
+		boost::asio::ip::udp::endpoint endpoint = *udp_resolver.resolve({
 			boost::asio::ip::udp::v4(),
 			get_server_name(),
 			boost::lexical_cast<std::string>(get_port())});
+		{
+			std::lock_guard<std::mutex> lock(mutex_send);
+			udp_endpoint = endpoint;
+		}
 
 		for (int i = 0; i == 0 || (i == 1 && error); ++i)
-			udp_socket.send_to(boost::asio::buffer(request),
-				udp_endpoint, boost::asio::ip::udp::socket::message_flags(0),
-				error);
+			send_udp(request.data(), request.size(), error);
 		if (error) {
+			/** Its own code, the loop goes on the send's */
+			boost::system::error_code wait_error;
 			timer.expires_from_now(
 				boost::posix_time::seconds(CONNECTION_RETRY_TIME_SEC));
-			timer.wait();
+			timer.wait(wait_error);
 		}
 	} while (error);
 
-	log() << "UDP connected!\n";
+	EM_LOG << "UDP connected!\n";
 
 	touch_connection();
 
@@ -228,15 +436,38 @@ void EMClient::keep_alive_routine()
 
 	boost::system::error_code error;
 
+	static const uint TICKS_PER_SEC = 1000 / KEEP_ALIVE_TIMEOUT_MS;
+	uint64_t last_heard   = heard;
+	uint64_t last_reports = reports;
+	uint silent     = 0;
+	uint unreported = 0;
+
 	while (true) {
 		timer.expires_from_now(boost::posix_time::milliseconds(KEEP_ALIVE_TIMEOUT_MS));
-		timer.wait();
+		timer.wait(error);
+
+		silent       = heard == last_heard ? silent + 1 : 0;
+		unreported   = reports == last_reports ? unreported + 1 : 0;
+		last_heard   = heard;
+		last_reports = reports;
+
+		/** The path may have changed under us, a RESUME also brings us back from a new address */
+		if (token != 0 && silent >= CONNECTION_EXPIRY_TIME_SEC * TICKS_PER_SEC) {
+			send_resume(0, 0);
+		} else {
+			send_udp(request, std::strlen(request), error);
+			if (error)
+				return connect_udp();
+		}
 
-		udp_socket.send_to(
-			boost::asio::buffer(request, std::strlen(request)), udp_endpoint,
-			boost::asio::ip::udp::socket::message_flags(0), error);
-		if (error)
-			return connect_udp();
+		/** TCP would take minutes to notice, breaking the read makes the main loop resume */
+		if (token != 0 && std::max(silent, unreported) >= RECONNECT_TIME_SEC * TICKS_PER_SEC) {
+			EM_INFO << "No word from the server, reconnecting.\n";
+			stale_connection = true;
+			::shutdown(tcp_socket.native_handle(), SHUT_RDWR);
+			silent     = 0;
+			unreported = 0;
+		}
 	}
 }
 
@@ -247,30 +478,42 @@ void EMClient::server_interaction_routine()
 
 	acknowledged = 0;
 	sent         = 0;
-	expected     = 0;
 	window_size  = 64;
 
+	{
+		std::lock_guard<std::mutex> lock(mutex_output);
+		reorder.reset(new ReorderBuffer(get_retransmit_limit(),
+			std::bind(&EMClient::write_output, this,
+				std::placeholders::_1, std::placeholders::_2)));
+		retransmit_requested = false;
+	}
+
 	boost::system::error_code error;
 	boost::array<char, BUFFER_SIZE> buf;
+	/** Not udp_endpoint, the other threads send to it meanwhile */
+	boost::asio::ip::udp::endpoint sender_endpoint;
 
 	while (is_connected()) {
 		insert_input();
 
 		size_t length =
 			udp_socket.receive_from(boost::asio::buffer(buf),
-			udp_endpoint, boost::asio::ip::udp::socket::message_flags(0), error);
-		output_buffer = std::string(buf.begin(), buf.begin() + length);
+			sender_endpoint, boost::asio::ip::udp::socket::message_flags(0), error);
 
 		if (error)
 			set_connected(false);
 
-		switch (EM::Messages::get_type(output_buffer)) {
+		/** Only the header is parsed, the payload stays in the receive buffer */
+		std::string header(buf.data(), get_header_length(buf.data(), length));
+
+		switch (EM::Messages::get_type(header)) {
 			case EM::Messages::Type::Ack: {
 				uint ack;
 				size_t win;
-				if (!EM::Messages::read_ack(output_buffer, ack, win))
+				if (!EM::Messages::read_ack(header, ack, win))
 					break;
-				log() << "READ " << output_buffer;
+				EM_LOG << "READ " << header << "\n";
+				++heard;
 
 				acknowledged = ack;
 				window_size  = win;
@@ -280,31 +523,8 @@ void EMClient::server_interaction_routine()
 				break;
 			}
 			case EM::Messages::Type::Data: {
-				uint nr, ack;
-				size_t win;
-				if (!EM::Messages::read_data(output_buffer, nr, ack, win))
-					break;
-
-				acknowledged = std::max(ack, acknowledged);
-				window_size  = win;
-
-				size_t index =
-					output_buffer.find("\n");
-				if (index >= output_buffer.size()) {
-					info() << "READ invalid DATA\n";
-					break;
-				}
-				out << output_buffer.substr(index + 1);
-				log() << "READ " << output_buffer.substr(0, index) << " (" 
-					<< output_buffer.size() - index - 1 << ")\n";
-
-				if (nr > expected && nr - expected <= get_retransmit_limit()) {
-					ask_retransmit(expected);
-				} else {
-					expected = nr + 1;
-					manage_messages();
-				}
-
+				++heard;
+				read_data(buf.data(), length, false);
 				break;
 			}
 			default:;
@@ -314,6 +534,79 @@ void EMClient::server_interaction_routine()
 	}
 }
 
+size_t EMClient::get_header_length(const char *message, size_t length)
+{
+	const char *end = (const char *) std::memchr(message, '\n', length);
+	return end == nullptr ? length : end - message;
+}
+
+void EMClient::read_data(const char *message, size_t length, bool from_group)
+{
+	size_t index = get_header_length(message, length);
+	std::string header(message, index);
+
+	uint nr, ack;
+	size_t win;
+	if (!EM::Messages::read_data(header, nr, ack, win))
+		return;
+
+	if (!from_group) {
+		acknowledged = std::max(ack, acknowledged);
+		window_size  = win;
+	}
+
+	if (index >= length) {
+		EM_INFO << "READ invalid DATA\n";
+		return;
+	}
+
+	bool ask = false;
+	uint missing;
+	{
+		std::lock_guard<std::mutex> lock(mutex_output);
+		if (reorder == nullptr)
+			return;
+
+		EM_LOG << "READ " << header << " (" << length - index - 1 << ")\n";
+		if (!reorder->push(nr, message + index + 1, length - index - 1))
+			EM_LOG << "Dropped duplicate " << nr << "\n";
+
+		/** One request per gap, the server resends everything from there */
+		missing = reorder->get_expected();
+		if (reorder->has_gap() && (!retransmit_requested || retransmit_nr != missing)) {
+			ask = true;
+			retransmit_requested = true;
+			retransmit_nr        = missing;
+		}
+	}
+
+	if (ask)
+		ask_retransmit(missing);
+	/** The group thread leaves the uploads to the unicast one, ACKs drive them there */
+	if (!from_group)
+		manage_messages();
+}
+
+void EMClient::write_output(const char *data, size_t length)
+{
+	if (output_fd < 0) {
+		out.write(data, length);
+		return;
+	}
+
+	while (length > 0) {
+		ssize_t written = ::write(output_fd, data, length);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			EM_WARN << "Unable to write the output.\n";
+			return;
+		}
+		data   += written;
+		length -= written;
+	}
+}
+
 void EMClient::insert_input()
 {
 	std::string input;
@@ -325,7 +618,7 @@ void EMClient::insert_input()
 void EMClient::manage_messages()
 {
 	if (acknowledged < sent) {
-		log() << "Retransmitting\n";
+		EM_LOG << "Retransmitting\n";
 		for (uint i = acknowledged; i < sent; ++i)
 			if (messages.find(i) != messages.end())
 				send_data(messages[i], i);
@@ -354,11 +647,9 @@ bool EMClient::ask_retransmit(uint number)
 
 	boost::system::error_code error;
 
-	log() << "SEND " << message;
+	EM_LOG << "SEND " << message;
 
-	udp_socket.send_to(
-		boost::asio::buffer(message, std::strlen(message)), udp_endpoint,
-		boost::asio::ip::udp::socket::message_flags(0), error);
+	send_udp(message, std::strlen(message), error);
 
 	return (bool) !error;
 }
@@ -371,20 +662,23 @@ bool EMClient::send_data(const std::string &data, uint number)
 	std::sprintf(&output[0] , EM::Messages::Upload.c_str(), number);
 	output = output.substr(0, output.find("\n") + 1);
 
-	log() << "SEND (" << data.size() << ") " << output;
+	EM_LOG << "SEND (" << data.size() << ") " << output;
 
 	output += data;
 
-	uint bytes_sent =
-		udp_socket.send_to(
-			boost::asio::buffer(output),
-			udp_endpoint,
-			boost::asio::ip::udp::socket::message_flags(0), error);
+	uint bytes_sent = send_udp(output.data(), output.size(), error);
 
 	if (error || bytes_sent < output.size()) {
-		warn() << "Unable to send data to server.\n";
+		EM_WARN << "Unable to send data to server.\n";
 		return false;
 	}
 
 	return true;
 }
+
+size_t EMClient::send_udp(const char *data, size_t length, boost::system::error_code &error)
+{
+	std::lock_guard<std::mutex> lock(mutex_send);
+	return udp_socket.send_to(boost::asio::buffer(data, length), udp_endpoint,
+		boost::asio::ip::udp::socket::message_flags(0), error);
+}
@@ -1,12 +1,17 @@
 #ifndef EMCLIENT_H
 #define EMCLIENT_H
 
+#include <atomic>
 #include <boost/asio.hpp>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 
+#include "Client/ReorderBuffer.h"
+
 class EMClient
 {
 public:
@@ -21,7 +26,18 @@ public:
 	void set_retransmit_limit(uint retransmit_limit);
 	uint get_retransmit_limit() const;
 
+	void set_sample_rate(uint sample_rate);
+	uint get_sample_rate() const;
+	void set_channels(uint channels);
+	uint get_channels() const;
+
+	/** Writes the mix straight to a descriptor, unbuffered, instead of the stream */
+	void set_output_fd(int output_fd);
+	int get_output_fd() const;
+
+	/** Returns once stopped by quit() */
 	void start();
+	/** Only raises a flag and wakes the TCP read, safe from a signal handler */
 	void quit();
 
 private:
@@ -32,9 +48,16 @@ private:
 	std::string server_name;
 
 	uint cid;
+	/** From the server's greeting, 0 when it can't resume sessions */
+	uint64_t token;
 
 	uint retransmit_limit;
 
+	uint sample_rate;
+	uint channels;
+
+	int output_fd;
+
 	/** Connection */
 
 	bool is_connected() const;
@@ -46,12 +69,29 @@ private:
 	mutable std::mutex mutex_connected;
 	bool connected;
 
+	/** Session resume, the server keeps our state and takes us back in one round trip */
+
+	bool resume_session();
+	bool send_resume(uint connection_cid, uint64_t connection_token);
+
+	static const uint RESUME_TIMEOUT_MS  = 200;
+	static const uint RESUME_ATTEMPTS    = 3;
+	/** Silence after which the TCP connection is given up and made anew */
+	static const uint RECONNECT_TIME_SEC = 3;
+
+	/** ACK and DATA from the server, and reports, counted to notice silence */
+	std::atomic<uint64_t> heard;
+	std::atomic<uint64_t> reports;
+	/** Set when the TCP connection was broken on purpose, no point in waiting on it */
+	std::atomic<bool> stale_connection;
+	std::atomic<bool> stop_requested;
+
 	boost::asio::io_service io_service;
 
 	/** TCP */
 
-	bool connect_tcp();
-	bool read_init_message();
+	bool connect_tcp(uint &cid, uint64_t &token);
+	bool read_init_message(uint &cid, uint64_t &token);
 
 	boost::asio::ip::tcp::socket tcp_socket;
 	boost::asio::ip::tcp::resolver tcp_resolver;
@@ -64,28 +104,52 @@ private:
 	static const uint KEEP_ALIVE_TIMEOUT_MS = 500;
 
 	void server_interaction_routine();
+	/** Unicast DATA carries this client's ACK and window, group DATA doesn't */
+	void read_data(const char *message, size_t length, bool from_group);
+	void write_output(const char *data, size_t length);
+	static size_t get_header_length(const char *message, size_t length);
 	void insert_input();
 	void manage_messages();
 	void print_data();
 
 	std::unordered_map<uint, std::string> messages;
 	std::string input_buffer;
-	std::string output_buffer;
 
 	uint   acknowledged;
 	uint   sent;
-	uint   expected;
 	size_t window_size;
 
+	/** Under mutex_output, the multicast thread delivers too */
+	std::unique_ptr<ReorderBuffer> reorder;
+	bool retransmit_requested;
+	uint retransmit_nr;
+
 	bool ask_retransmit(uint number);
 	bool send_data(const std::string &data, uint number);
 
+	/** Every thread sends through here, the socket takes one at a time */
+	size_t send_udp(const char *data, size_t length, boost::system::error_code &error);
+	std::mutex mutex_send;
+
 	static const size_t MIN_DATA_SIZE = 16;
 
 	boost::asio::ip::udp::socket   udp_socket;
 	boost::asio::ip::udp::resolver udp_resolver;
 	boost::asio::ip::udp::endpoint udp_endpoint;
 
+	/** Multicast, joined when the server announces a group */
+
+	bool join_multicast();
+	/** Before another group, or none, is taken on */
+	void leave_multicast();
+	void multicast_routine();
+
+	boost::asio::ip::udp::endpoint multicast_endpoint;
+	boost::asio::ip::udp::socket   multicast_socket;
+	std::thread multicast_thread;
+	/** The output and the reorder buffer, shared with the multicast thread */
+	std::mutex mutex_output;
+
 	static const size_t BUFFER_SIZE = 65536 << 2;
 	static const size_t MSG_SIZE    = 65536;
 };
@@ -0,0 +1,100 @@
+#include "Client/ReorderBuffer.h"
+
+/**
+ * \class ReorderBuffer
+ */
+
+ReorderBuffer::ReorderBuffer(uint limit, Output output) :
+	limit(limit),
+	output(output),
+
+	started(false),
+	expected(0),
+
+	slots(limit + 1),
+	filled(limit + 1, false),
+	held(0)
+{}
+
+bool ReorderBuffer::push(uint nr, const char *data, size_t length)
+{
+	if (!started) {
+		started  = true;
+		expected = nr;
+	}
+
+	/** Differences are taken modulo 2^32, so numbering may wrap */
+	uint ahead  = nr - expected;
+	uint behind = expected - nr;
+
+	if (behind > 0 && behind <= 2 * limit)
+		return false;
+
+	if (ahead > 2 * limit && behind > 2 * limit) {
+		/** Out of any window, the sequence starts over from this frame */
+		while (held > 0)
+			skip();
+		expected = nr;
+	}
+
+	/** Gaps the frame pushes out of the window are given up */
+	while (nr - expected > limit && nr - expected <= 2 * limit)
+		skip();
+	/** Playout moved past it, so it had been held already */
+	if (nr - expected > limit)
+		return false;
+
+	if (nr != expected) {
+		size_t slot = get_slot(nr);
+		if (filled[slot])
+			return false;
+		slots[slot].assign(data, length);
+		filled[slot] = true;
+		++held;
+		return true;
+	}
+
+	/** In order, played straight from the caller's buffer */
+	output(data, length);
+	++expected;
+	release();
+	return true;
+}
+
+uint ReorderBuffer::get_expected() const
+{
+	return expected;
+}
+
+bool ReorderBuffer::has_gap() const
+{
+	return held > 0;
+}
+
+void ReorderBuffer::release()
+{
+	while (held > 0 && filled[get_slot(expected)]) {
+		size_t slot = get_slot(expected);
+		output(slots[slot].data(), slots[slot].size());
+		filled[slot] = false;
+		--held;
+		++expected;
+	}
+}
+
+void ReorderBuffer::skip()
+{
+	size_t slot = get_slot(expected);
+	if (filled[slot]) {
+		output(slots[slot].data(), slots[slot].size());
+		filled[slot] = false;
+		--held;
+	}
+	++expected;
+	release();
+}
+
+size_t ReorderBuffer::get_slot(uint nr) const
+{
+	return nr % slots.size();
+}
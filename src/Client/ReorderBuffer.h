@@ -0,0 +1,49 @@
+#ifndef REORDERBUFFER_H
+#define REORDERBUFFER_H
+
+#include <functional>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * Puts the DATA datagrams back in order before they are played.
+ *
+ * Frames after a gap are held, in a ring of limit + 1 slots indexed by their
+ * number, until the gap is filled by a retransmission or the newest frame is
+ * limit ahead of it, when the gap is declared lost and playout skips it. Frames
+ * already played or already held are dropped, so retransmit bursts don't repeat
+ * any audio. A frame further than twice the limit either way restarts the
+ * sequence, as after the server's numbering jumped.
+ */
+class ReorderBuffer
+{
+public:
+	typedef std::function<void(const char *data, size_t length)> Output;
+
+	ReorderBuffer(uint limit, Output output);
+
+	/** Plays the frame and everything it unblocks; false if it was a duplicate */
+	bool push(uint nr, const char *data, size_t length);
+
+	/** The next frame to play, the first missing one while frames are held */
+	uint get_expected() const;
+	bool has_gap() const;
+
+private:
+	void release();
+	void skip();
+	size_t get_slot(uint nr) const;
+
+	uint limit;
+	Output output;
+
+	bool started;
+	uint expected;
+
+	std::vector<std::string> slots;
+	std::vector<bool> filled;
+	size_t held;
+};
+
+#endif // REORDERBUFFER_H
@@ -1,8 +1,10 @@
 #include <iostream>
+#include <unistd.h>
 
 #include "Client/EMClient.h"
 #include "System/ArgsManager.h"
 #include "System/Error.h"
+#include "System/Logging.h"
 #include "System/SignalHandler.h"
 #include "System/Strings.h"
 
@@ -11,8 +13,6 @@ EMClient *em_client_ptr;
 void quit()
 {
 	em_client_ptr->quit();
-	std::cerr << "\nClient quitting.\n";
-	exit(EXIT_SUCCESS);
 }
 
 int main(int argc, char **argv)
@@ -40,6 +40,19 @@ int main(int argc, char **argv)
 			case EM::Arg::BufferLength:
 				em_client.set_retransmit_limit(args_manager.get_uint());
 				break;
+			case EM::Arg::SampleRate:
+				em_client.set_sample_rate(args_manager.get_uint());
+				break;
+			case EM::Arg::Channels:
+				em_client.set_channels(args_manager.get_uint());
+				break;
+			case EM::Arg::DirectOutput:
+				em_client.set_output_fd(STDOUT_FILENO);
+				break;
+
+			case EM::Arg::Verbosity:
+				EM::Logging::set_level(args_manager.get_uint());
+				break;
 
 			default:
 				std::cerr << EM::Errors::to_string(EM::Error::UnknownArg) << ": "
@@ -55,5 +68,9 @@ int main(int argc, char **argv)
 
 	em_client.start();
 
-	return EXIT_SUCCESS;
+	/** Out of the signal handler, the drain thread may hold the logging's lock */
+	EM::Logging::flush();
+	std::cerr << "\nClient quitting.\n";
+	/** The UDP and input threads never return */
+	exit(EXIT_SUCCESS);
 }
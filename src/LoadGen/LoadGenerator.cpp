@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <iomanip>
+#include <limits>
+
+#include "LoadGen/LoadGenerator.h"
+#include "System/Logging.h"
+#include "System/Utils.h"
+
+/**
+ * \class LoadGenerator
+ */
+
+const uint LoadGenerator::TICK_MS;
+const uint LoadGenerator::REPORT_MS;
+
+LoadGenerator::LoadGenerator(std::ostream &out) :
+	out(out),
+
+	port(EM::Default::PORT),
+
+	clients_number(EM::Default::LOADGEN_CLIENTS),
+	rate(EM::Default::LOADGEN_RATE),
+	duration(EM::Default::LOADGEN_DURATION),
+	retransmit_limit(EM::Default::RETRANSMIT_LIMIT),
+
+	io_service(),
+	tick_timer(io_service),
+	report_timer(io_service),
+
+	previous_total(),
+	reports(0)
+{}
+
+void LoadGenerator::set_port(uint port)
+{
+	this->port = port;
+}
+
+uint LoadGenerator::get_port() const
+{
+	return port;
+}
+
+void LoadGenerator::set_server_name(const std::string &server_name)
+{
+	this->server_name = server_name;
+}
+
+std::string LoadGenerator::get_server_name() const
+{
+	return server_name;
+}
+
+void LoadGenerator::set_clients_number(uint clients_number)
+{
+	this->clients_number = clients_number;
+}
+
+uint LoadGenerator::get_clients_number() const
+{
+	return clients_number;
+}
+
+void LoadGenerator::set_rate(uint rate)
+{
+	this->rate = rate;
+}
+
+uint LoadGenerator::get_rate() const
+{
+	return rate;
+}
+
+void LoadGenerator::set_duration(uint duration)
+{
+	this->duration = duration;
+}
+
+uint LoadGenerator::get_duration() const
+{
+	return duration;
+}
+
+void LoadGenerator::set_retransmit_limit(uint retransmit_limit)
+{
+	this->retransmit_limit = retransmit_limit;
+}
+
+uint LoadGenerator::get_retransmit_limit() const
+{
+	return retransmit_limit;
+}
+
+void LoadGenerator::start()
+{
+	std::string service = boost::lexical_cast<std::string>(get_port());
+
+	boost::asio::ip::tcp::resolver tcp_resolver(io_service);
+	boost::asio::ip::tcp::endpoint tcp_endpoint =
+		*tcp_resolver.resolve({boost::asio::ip::tcp::v4(), get_server_name(), service});
+
+	boost::asio::ip::udp::resolver udp_resolver(io_service);
+	boost::asio::ip::udp::endpoint udp_endpoint =
+		*udp_resolver.resolve({boost::asio::ip::udp::v4(), get_server_name(), service});
+
+	EM_WARN << "Starting " << get_clients_number() << " clients against "
+		<< udp_endpoint << " at " << get_rate() << " B/s each.\n";
+
+	for (uint i = 0; i < get_clients_number(); ++i) {
+		clients.emplace_back(new SimulatedClient(io_service, i, get_rate(),
+			get_retransmit_limit(), inter_arrival_histogram));
+		clients.back()->start(tcp_endpoint, udp_endpoint);
+	}
+
+	start_time = SimulatedClient::Clock::now();
+
+	tick_timer.expires_from_now(boost::posix_time::milliseconds(TICK_MS));
+	tick_timer.async_wait(boost::bind(&LoadGenerator::tick_routine, this));
+
+	report_timer.expires_from_now(boost::posix_time::milliseconds(REPORT_MS));
+	report_timer.async_wait(boost::bind(&LoadGenerator::report_routine, this));
+
+	io_service.run();
+
+	print_summary();
+}
+
+void LoadGenerator::quit()
+{
+	io_service.stop();
+}
+
+void LoadGenerator::tick_routine()
+{
+	/** Relative to the previous expiry, so the pacing does not drift */
+	tick_timer.expires_at(tick_timer.expires_at() + boost::posix_time::milliseconds(TICK_MS));
+	tick_timer.async_wait(boost::bind(&LoadGenerator::tick_routine, this));
+
+	SimulatedClient::Clock::time_point now = SimulatedClient::Clock::now();
+	for (auto &client : clients)
+		client->tick(now);
+}
+
+void LoadGenerator::report_routine()
+{
+	report_timer.expires_at(report_timer.expires_at() + boost::posix_time::milliseconds(REPORT_MS));
+	report_timer.async_wait(boost::bind(&LoadGenerator::report_routine, this));
+
+	++reports;
+	print_report(REPORT_MS / 1000.0);
+
+	if (get_duration() != 0 && reports * REPORT_MS >= get_duration() * 1000)
+		quit();
+}
+
+SimulatedClient::Statistics LoadGenerator::get_total_statistics() const
+{
+	SimulatedClient::Statistics total = SimulatedClient::Statistics();
+	total.fifo_min = std::numeric_limits<uint>::max();
+
+	for (auto &client : clients) {
+		const SimulatedClient::Statistics &s = client->get_statistics();
+
+		total.connected             += s.connected;
+		total.uploads               += s.uploads;
+		total.bytes_uploaded        += s.bytes_uploaded;
+		total.uploads_retransmitted += s.uploads_retransmitted;
+		total.source_overrun_bytes  += s.source_overrun_bytes;
+		total.data_frames           += s.data_frames;
+		total.data_bytes            += s.data_bytes;
+		total.duplicates            += s.duplicates;
+		total.lost                  += s.lost;
+		total.recovered             += s.recovered;
+		total.retransmits_requested += s.retransmits_requested;
+		total.frames_expected       += s.frames_expected;
+		total.jitter_ms              = std::max(total.jitter_ms, s.jitter_ms);
+		total.fifo_size             += s.fifo_size;
+		total.fifo_max_size          = std::max(total.fifo_max_size, s.fifo_max_size);
+		total.fifo_min               = std::min(total.fifo_min, s.fifo_min);
+		total.fifo_max               = std::max(total.fifo_max, s.fifo_max);
+	}
+
+	return total;
+}
+
+void LoadGenerator::print_report(double seconds)
+{
+	SimulatedClient::Statistics total = get_total_statistics();
+	SimulatedClient::Statistics &previous = previous_total;
+	Histogram::Snapshot inter_arrival = inter_arrival_histogram.get_snapshot();
+
+	uint connected = 0;
+	for (auto &client : clients)
+		connected += client->get_statistics().connected;
+
+	out << std::fixed << std::setprecision(2)
+	    << "[" << reports << "s] clients " << connected << "/" << clients.size()
+	    << " | up " << (total.bytes_uploaded - previous.bytes_uploaded) / seconds / 1e6
+	    << " MB/s, " << (total.uploads - previous.uploads) / seconds << " pkt/s"
+	    << ", rtx " << total.uploads_retransmitted - previous.uploads_retransmitted
+	    << ", overrun " << total.source_overrun_bytes - previous.source_overrun_bytes << " B"
+	    << " | down " << (total.data_bytes - previous.data_bytes) / seconds / 1e6
+	    << " MB/s, " << (total.data_frames - previous.data_frames) / seconds << " pkt/s"
+	    << ", lost " << total.lost - previous.lost
+	    << ", dup " << total.duplicates - previous.duplicates
+	    << ", rtx req " << total.retransmits_requested - previous.retransmits_requested
+	    << " | jitter max " << total.jitter_ms << " ms"
+	    << ", gap p50 " << inter_arrival.get_percentile(50) / 1000.0
+	    << " p99 " << inter_arrival.get_percentile(99) / 1000.0
+	    << " max " << inter_arrival.get_max() / 1000.0 << " ms"
+	    << " | FIFO avg " << (connected > 0 ? total.fifo_size / connected : 0)
+	    << "/" << total.fifo_max_size
+	    << " (min. " << (connected > 0 ? total.fifo_min : 0) << ", max. " << total.fifo_max << ")"
+	    << "\n";
+
+	previous_total = total;
+}
+
+void LoadGenerator::print_summary()
+{
+	double seconds = std::chrono::duration<double>(
+		SimulatedClient::Clock::now() - start_time).count();
+
+	out << "\n" << std::setw(6) << "client" << std::setw(6) << "cid"
+	    << std::setw(12) << "up B/s" << std::setw(12) << "down B/s"
+	    << std::setw(10) << "frames" << std::setw(8) << "lost" << std::setw(8) << "loss%"
+	    << std::setw(8) << "dup" << std::setw(10) << "jitter"
+	    << std::setw(14) << "FIFO" << "\n";
+
+	for (size_t i = 0; i < clients.size(); ++i) {
+		const SimulatedClient::Statistics &s = clients[i]->get_statistics();
+		out << std::setw(6) << i << std::setw(6) << s.cid
+		    << std::setw(12) << std::setprecision(0) << s.bytes_uploaded / seconds
+		    << std::setw(12) << s.data_bytes / seconds
+		    << std::setw(10) << s.data_frames
+		    << std::setw(8) << s.lost
+		    << std::setw(8) << std::setprecision(2)
+		    << (s.frames_expected > 0 ? 100.0 * s.lost / s.frames_expected : 0.0)
+		    << std::setw(8) << s.duplicates
+		    << std::setw(10) << s.jitter_ms
+		    << std::setw(14) << std::to_string(s.fifo_size) + "/" + std::to_string(s.fifo_max_size)
+		    << "\n";
+	}
+
+	SimulatedClient::Statistics total = get_total_statistics();
+	Histogram::Snapshot inter_arrival = inter_arrival_histogram.get_snapshot();
+
+	out << "\nTotal over " << std::setprecision(1) << seconds << " s: "
+	    << std::setprecision(2)
+	    << "up " << total.bytes_uploaded / seconds / 1e6 << " MB/s"
+	    << ", down " << total.data_bytes / seconds / 1e6 << " MB/s"
+	    << ", loss " << (total.frames_expected > 0 ? 100.0 * total.lost / total.frames_expected : 0.0)
+	    << "% (" << total.lost << "/" << total.frames_expected << ", " << total.recovered
+	    << " recovered)"
+	    << ", DATA inter-arrival p50 " << inter_arrival.get_percentile(50) / 1000.0
+	    << " p99 " << inter_arrival.get_percentile(99) / 1000.0
+	    << " p99.9 " << inter_arrival.get_percentile(99.9) / 1000.0
+	    << " max " << inter_arrival.get_max() / 1000.0 << " ms\n";
+}
@@ -0,0 +1,72 @@
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <boost/asio.hpp>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "LoadGen/SimulatedClient.h"
+#include "System/Histogram.h"
+
+/**
+ * Simulates many E-Meeting clients against a running server from one process
+ * and reports throughput, loss, jitter and the server FIFO statistics.
+ */
+class LoadGenerator
+{
+public:
+	LoadGenerator(std::ostream &out);
+
+	void set_port(uint port);
+	uint get_port() const;
+	void set_server_name(const std::string &server_name);
+	std::string get_server_name() const;
+
+	void set_clients_number(uint clients_number);
+	uint get_clients_number() const;
+	void set_rate(uint rate);
+	uint get_rate() const;
+	void set_duration(uint duration);
+	uint get_duration() const;
+	void set_retransmit_limit(uint retransmit_limit);
+	uint get_retransmit_limit() const;
+
+	void start();
+	void quit();
+
+private:
+	void tick_routine();
+	void report_routine();
+
+	SimulatedClient::Statistics get_total_statistics() const;
+	void print_report(double seconds);
+	void print_summary();
+
+	std::ostream &out;
+
+	uint port;
+	std::string server_name;
+
+	uint clients_number;
+	uint rate;
+	uint duration;
+	uint retransmit_limit;
+
+	boost::asio::io_service io_service;
+	boost::asio::deadline_timer tick_timer;
+	boost::asio::deadline_timer report_timer;
+
+	std::vector<std::unique_ptr<SimulatedClient> > clients;
+	Histogram inter_arrival_histogram;
+
+	SimulatedClient::Clock::time_point start_time;
+	SimulatedClient::Statistics previous_total;
+	uint reports;
+
+	static const uint TICK_MS   = 5;
+	static const uint REPORT_MS = 1000;
+};
+
+#endif // LOADGENERATOR_H
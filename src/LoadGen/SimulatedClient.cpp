@@ -0,0 +1,351 @@
+#include <boost/bind.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "LoadGen/SimulatedClient.h"
+#include "Server/Mixer.h"
+#include "System/Logging.h"
+#include "System/Messages.h"
+#include "System/Utils.h"
+
+/**
+ * \class SimulatedClient
+ */
+
+const uint SimulatedClient::RETRANSMIT_TIMEOUT_MS;
+const uint SimulatedClient::KEEP_ALIVE_TIMEOUT_MS;
+
+SimulatedClient::SimulatedClient(
+	boost::asio::io_service &io_service,
+	uint index,
+	uint rate,
+	uint retransmit_limit,
+	Histogram &inter_arrival_histogram) :
+
+	index(index),
+	rate(rate),
+	retransmit_limit(retransmit_limit),
+
+	inter_arrival_histogram(inter_arrival_histogram),
+
+	tcp_socket(io_service),
+	udp_socket(io_service, boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), 0)),
+
+	acknowledged(0),
+	sent(0),
+	window_size(0),
+	pending_bytes(0),
+	phase(index * 37),
+
+	data_seen(false),
+	expected(0),
+	last_arrival_nr(0),
+
+	statistics()
+{}
+
+void SimulatedClient::start(
+	const boost::asio::ip::tcp::endpoint &tcp_endpoint,
+	const boost::asio::ip::udp::endpoint &udp_endpoint)
+{
+	this->tcp_endpoint = tcp_endpoint;
+	this->udp_endpoint = udp_endpoint;
+
+	tcp_socket.async_connect(tcp_endpoint,
+		boost::bind(&SimulatedClient::handle_connect, this,
+			boost::asio::placeholders::error));
+}
+
+void SimulatedClient::tick(Clock::time_point now)
+{
+	if (!statistics.connected) {
+		last_tick = now;
+		return;
+	}
+
+	double elapsed = std::chrono::duration<double>(now - last_tick).count();
+	last_tick = now;
+
+	/** The sound card keeps producing data whether the server takes it or not */
+	pending_bytes += elapsed * rate;
+	double max_pending = (double) rate * MAX_PENDING_MS / 1000;
+	if (pending_bytes > max_pending) {
+		statistics.source_overrun_bytes += (uint64_t) (pending_bytes - max_pending);
+		pending_bytes = max_pending;
+	}
+
+	upload(now);
+
+	if (now - last_keep_alive >= std::chrono::milliseconds(KEEP_ALIVE_TIMEOUT_MS)) {
+		send_udp(EM::Messages::KeepAlive);
+		last_keep_alive = now;
+	}
+}
+
+const SimulatedClient::Statistics &SimulatedClient::get_statistics() const
+{
+	return statistics;
+}
+
+void SimulatedClient::handle_connect(const boost::system::error_code &error)
+{
+	if (error) {
+		EM_WARN << "Client " << index << ": unable to connect.\n";
+		return;
+	}
+	tcp_receive_routine();
+}
+
+void SimulatedClient::tcp_receive_routine()
+{
+	tcp_socket.async_read_some(boost::asio::buffer(tcp_buffer),
+		boost::bind(&SimulatedClient::handle_tcp_receive, this,
+			boost::asio::placeholders::error,
+			boost::asio::placeholders::bytes_transferred));
+}
+
+void SimulatedClient::handle_tcp_receive(const boost::system::error_code &error, size_t length)
+{
+	if (error) {
+		EM_WARN << "Client " << index << ": TCP connection lost.\n";
+		statistics.connected = false;
+		return;
+	}
+
+	tcp_pending.append(tcp_buffer.data(), length);
+	size_t end;
+	while ((end = tcp_pending.find('\n')) != std::string::npos) {
+		read_tcp_line(tcp_pending.substr(0, end));
+		tcp_pending.erase(0, end + 1);
+	}
+
+	tcp_receive_routine();
+}
+
+void SimulatedClient::read_tcp_line(const std::string &line)
+{
+	uint cid;
+	if (!statistics.connected && EM::Messages::read_client(line, cid)) {
+		statistics.cid       = cid;
+		statistics.connected = true;
+
+		last_tick = last_upload = last_keep_alive = Clock::now();
+
+		char request[EM::Messages::LENGTH];
+		std::snprintf(request, EM::Messages::LENGTH, EM::Messages::Client.c_str(), cid);
+		send_udp(request);
+
+		EM_INFO << "Client " << index << " connected as " << cid << ".\n";
+		udp_receive_routine();
+		return;
+	}
+
+	/** The report line of this client, the server names it by its UDP endpoint */
+	char name[EM::Messages::LENGTH];
+	uint size, max_size, min, max;
+	if (line.size() < EM::Messages::LENGTH
+		&& std::sscanf(line.c_str(), "%127s FIFO: %u/%u (min. %u, max. %u)",
+			name, &size, &max_size, &min, &max) == 5) {
+		std::string suffix = ":" + std::to_string(udp_socket.local_endpoint().port());
+		std::string address(name);
+		if (address.size() > suffix.size()
+			&& address.compare(address.size() - suffix.size(), suffix.size(), suffix) == 0) {
+			statistics.fifo_size     = size;
+			statistics.fifo_max_size = max_size;
+			statistics.fifo_min      = min;
+			statistics.fifo_max      = max;
+		}
+	}
+}
+
+void SimulatedClient::udp_receive_routine()
+{
+	udp_socket.async_receive_from(boost::asio::buffer(udp_buffer), sender_endpoint,
+		boost::bind(&SimulatedClient::handle_udp_receive, this,
+			boost::asio::placeholders::error,
+			boost::asio::placeholders::bytes_transferred));
+}
+
+void SimulatedClient::handle_udp_receive(const boost::system::error_code &error, size_t length)
+{
+	if (error) {
+		EM_WARN << "Client " << index << ": UDP error.\n";
+		return;
+	}
+
+	switch (EM::Messages::get_type(udp_buffer.data(), length)) {
+		case EM::Messages::Type::Ack: {
+			uint ack;
+			size_t win;
+			if (EM::Messages::read_ack(std::string(udp_buffer.data(), length), ack, win)) {
+				acknowledged = ack;
+				window_size  = win;
+			}
+			break;
+		}
+		case EM::Messages::Type::Data: {
+			read_data(udp_buffer.data(), length);
+			break;
+		}
+		default:;
+			/** Ignored */
+	}
+
+	udp_receive_routine();
+}
+
+void SimulatedClient::read_data(const char *message, size_t length)
+{
+	const char *end = (const char *) std::memchr(message, '\n', length);
+	if (end == nullptr)
+		return;
+
+	uint nr, ack, interval;
+	size_t win;
+	if (!EM::Messages::read_data(std::string(message, end - message), nr, ack, win, interval))
+		return;
+
+	acknowledged = std::max(ack, acknowledged);
+	window_size  = win;
+
+	size_t payload = length - (end - message) - 1;
+	Clock::time_point now = Clock::now();
+
+	if (!data_seen) {
+		data_seen       = true;
+		expected        = nr;
+		last_arrival    = now;
+		last_arrival_nr = nr;
+	}
+
+	if (nr >= expected) {
+		if (nr > expected) {
+			for (uint i = expected; i < nr; ++i)
+				missing.insert(i);
+			if (nr - expected <= retransmit_limit) {
+				send_retransmit(expected);
+				++statistics.retransmits_requested;
+			}
+		}
+
+		/** Interarrival jitter as in RFC 3550, against the nominal frame spacing */
+		if (nr > last_arrival_nr) {
+			double arrival_ms =
+				std::chrono::duration<double, std::milli>(now - last_arrival).count();
+			/** Older servers leave the frame length out, it follows from the payload */
+			double frame_ms = interval != 0 ? interval : (double) payload / Mixer::DATA_MS_SIZE;
+			double nominal_ms = frame_ms * (nr - last_arrival_nr);
+			statistics.jitter_ms +=
+				(std::fabs(arrival_ms - nominal_ms) - statistics.jitter_ms) / 16;
+			inter_arrival_histogram.record(
+				std::chrono::duration_cast<std::chrono::microseconds>(
+					now - last_arrival).count());
+		}
+		last_arrival    = now;
+		last_arrival_nr = nr;
+
+		statistics.frames_expected += nr - expected + 1;
+		expected = nr + 1;
+		++statistics.data_frames;
+		statistics.data_bytes += payload;
+	} else if (missing.erase(nr) > 0) {
+		++statistics.recovered;
+		++statistics.data_frames;
+		statistics.data_bytes += payload;
+	} else {
+		++statistics.duplicates;
+	}
+
+	/** Frames older than twice the retransmit window won't come any more */
+	while (!missing.empty() && *missing.begin() + 2 * retransmit_limit < expected) {
+		missing.erase(missing.begin());
+		++statistics.lost;
+	}
+}
+
+void SimulatedClient::upload(Clock::time_point now)
+{
+	if (acknowledged < sent) {
+		if (now - last_upload < std::chrono::milliseconds(RETRANSMIT_TIMEOUT_MS))
+			return;
+		for (uint i = acknowledged; i < sent; ++i) {
+			auto it = messages.find(i);
+			if (it != messages.end()) {
+				send_upload(i, it->second);
+				++statistics.uploads_retransmitted;
+			}
+		}
+		last_upload = now;
+		/** We don't want too many retransmits */
+		++acknowledged;
+		return;
+	}
+
+	if (window_size < MIN_DATA_SIZE || pending_bytes < MIN_DATA_SIZE)
+		return;
+
+	size_t length = std::min((size_t) pending_bytes, window_size);
+	length -= length % sizeof(EM::data_t);
+
+	messages[sent] = generate_pcm(length);
+	send_upload(sent, messages[sent]);
+	++sent;
+
+	window_size   -= length;
+	pending_bytes -= length;
+	last_upload    = now;
+
+	++statistics.uploads;
+	statistics.bytes_uploaded += length;
+
+	auto old_message = messages.find(sent - retransmit_limit - 1);
+	if (old_message != messages.end())
+		messages.erase(old_message);
+}
+
+void SimulatedClient::send_upload(uint nr, const std::string &data)
+{
+	char header[EM::Messages::LENGTH];
+	int length = std::snprintf(header, EM::Messages::LENGTH, EM::Messages::Upload.c_str(), nr);
+	send_udp(std::string(header, length) + data);
+}
+
+void SimulatedClient::send_retransmit(uint nr)
+{
+	char message[EM::Messages::LENGTH];
+	std::snprintf(message, EM::Messages::LENGTH, EM::Messages::Retransmit.c_str(), nr);
+	send_udp(message);
+}
+
+void SimulatedClient::send_udp(const std::string &message)
+{
+	boost::system::error_code error;
+	udp_socket.send_to(boost::asio::buffer(message), udp_endpoint,
+		boost::asio::ip::udp::socket::message_flags(0), error);
+	if (error)
+		EM_LOG << "Client " << index << ": unable to send.\n";
+}
+
+std::string SimulatedClient::generate_pcm(size_t length)
+{
+	/** One period of a quiet 100 Hz tone at 44.1 kHz, stereo */
+	static const size_t PERIOD = 441;
+	static std::vector<EM::data_t> tone;
+	if (tone.empty()) {
+		for (size_t i = 0; i < PERIOD; ++i) {
+			EM::data_t sample = (EM::data_t) (256 * std::sin(2 * M_PI * i / PERIOD));
+			tone.push_back(sample);
+			tone.push_back(sample);
+		}
+	}
+
+	std::string data(length, '\0');
+	EM::data_t *samples = (EM::data_t *) &data[0];
+	for (size_t i = 0; i < length / sizeof(EM::data_t); ++i) {
+		samples[i] = tone[phase];
+		phase = (phase + 1) % tone.size();
+	}
+	return data;
+}
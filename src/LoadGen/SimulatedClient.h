@@ -0,0 +1,121 @@
+#ifndef SIMULATEDCLIENT_H
+#define SIMULATEDCLIENT_H
+
+#include <boost/array.hpp>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+
+#include "System/Histogram.h"
+
+/**
+ * One client of the load generator, speaking the same TCP and UDP protocol
+ * as EMClient but without any audio I/O. Driven entirely by the io_service
+ * of the load generator, so none of its state is locked.
+ */
+class SimulatedClient
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	SimulatedClient(
+		boost::asio::io_service &io_service,
+		uint index,
+		uint rate,
+		uint retransmit_limit,
+		Histogram &inter_arrival_histogram);
+
+	void start(
+		const boost::asio::ip::tcp::endpoint &tcp_endpoint,
+		const boost::asio::ip::udp::endpoint &udp_endpoint);
+	void tick(Clock::time_point now);
+
+	struct Statistics {
+		bool connected;
+		uint cid;
+
+		uint64_t uploads;
+		uint64_t bytes_uploaded;
+		uint64_t uploads_retransmitted;
+		uint64_t source_overrun_bytes;
+
+		uint64_t data_frames;
+		uint64_t data_bytes;
+		uint64_t duplicates;
+		uint64_t lost;
+		uint64_t recovered;
+		uint64_t retransmits_requested;
+		uint64_t frames_expected;
+
+		double jitter_ms;
+
+		uint fifo_size;
+		uint fifo_max_size;
+		uint fifo_min;
+		uint fifo_max;
+	};
+
+	const Statistics &get_statistics() const;
+
+private:
+	void handle_connect(const boost::system::error_code &error);
+	void tcp_receive_routine();
+	void handle_tcp_receive(const boost::system::error_code &error, size_t length);
+	void read_tcp_line(const std::string &line);
+
+	void udp_receive_routine();
+	void handle_udp_receive(const boost::system::error_code &error, size_t length);
+	void read_data(const char *message, size_t length);
+
+	void upload(Clock::time_point now);
+	void send_upload(uint nr, const std::string &data);
+	void send_retransmit(uint nr);
+	void send_udp(const std::string &message);
+
+	std::string generate_pcm(size_t length);
+
+	uint index;
+	uint rate;
+	uint retransmit_limit;
+
+	Histogram &inter_arrival_histogram;
+
+	boost::asio::ip::tcp::socket tcp_socket;
+	boost::asio::ip::tcp::endpoint tcp_endpoint;
+	boost::asio::ip::udp::socket udp_socket;
+	boost::asio::ip::udp::endpoint udp_endpoint;
+	boost::asio::ip::udp::endpoint sender_endpoint;
+
+	boost::array<char, 4096>  tcp_buffer;
+	boost::array<char, 65536> udp_buffer;
+	std::string tcp_pending;
+
+	/** Upload state, mirrors EMClient */
+	uint acknowledged;
+	uint sent;
+	size_t window_size;
+	double pending_bytes;
+	size_t phase;
+	std::map<uint, std::string> messages;
+	Clock::time_point last_tick;
+	Clock::time_point last_upload;
+	Clock::time_point last_keep_alive;
+
+	/** Download state */
+	bool data_seen;
+	uint expected;
+	std::set<uint> missing;
+	Clock::time_point last_arrival;
+	uint last_arrival_nr;
+
+	Statistics statistics;
+
+	static const size_t MIN_DATA_SIZE          = 16;
+	static const uint   MAX_PENDING_MS         = 1000;
+	static const uint   RETRANSMIT_TIMEOUT_MS  = 20;
+	static const uint   KEEP_ALIVE_TIMEOUT_MS  = 500;
+};
+
+#endif // SIMULATEDCLIENT_H
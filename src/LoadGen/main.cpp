@@ -0,0 +1,72 @@
+#include <iostream>
+
+#include "LoadGen/LoadGenerator.h"
+#include "System/ArgsManager.h"
+#include "System/Error.h"
+#include "System/Logging.h"
+#include "System/SignalHandler.h"
+#include "System/Strings.h"
+
+LoadGenerator *load_generator_ptr;
+
+void quit()
+{
+	load_generator_ptr->quit();
+}
+
+int main(int argc, char **argv)
+{
+	ArgsManager args_manager(argc - 1, argv + 1);
+
+	LoadGenerator load_generator(std::cout);
+	load_generator_ptr = &load_generator;
+
+	SignalHandler::setup((int) SIGINT, quit);
+
+	while (!args_manager.finished()) {
+		switch (args_manager.get_arg()) {
+			case EM::Arg::Help:
+				std::cout << EM::Strings::LoadGen::HelpMessage;
+				return EXIT_SUCCESS;
+
+			case EM::Arg::Port:
+				load_generator.set_port(args_manager.get_uint());
+				break;
+			case EM::Arg::ServerName:
+				load_generator.set_server_name(args_manager.get_string());
+				break;
+
+			case EM::Arg::Clients:
+				load_generator.set_clients_number(args_manager.get_uint());
+				break;
+			case EM::Arg::Rate:
+				load_generator.set_rate(args_manager.get_uint());
+				break;
+			case EM::Arg::Duration:
+				load_generator.set_duration(args_manager.get_uint());
+				break;
+
+			case EM::Arg::BufferLength:
+				load_generator.set_retransmit_limit(args_manager.get_uint());
+				break;
+
+			case EM::Arg::Verbosity:
+				EM::Logging::set_level(args_manager.get_uint());
+				break;
+
+			default:
+				std::cerr << EM::Errors::to_string(EM::Error::UnknownArg) << ": "
+				          << args_manager.get_previous_arg() << "\n";
+				return EXIT_SUCCESS;
+		}
+	}
+
+	if (!args_manager.arg_set(EM::Arg::ServerName)) {
+		std::cerr << EM::Errors::to_string(EM::Error::NoServerName) << "\n";
+		return EXIT_SUCCESS;
+	}
+
+	load_generator.start();
+
+	return EXIT_SUCCESS;
+}
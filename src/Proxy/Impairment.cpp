@@ -0,0 +1,63 @@
+#include "Proxy/Impairment.h"
+
+/**
+ * \class Impairment
+ */
+
+const uint Impairment::REORDER_DELAY_MS;
+
+Impairment::Impairment(const Parameters &parameters, uint32_t seed) :
+	parameters(parameters),
+	generator(seed),
+	uniform(0.0, 1.0),
+	in_burst(false),
+	statistics()
+{}
+
+std::vector<uint64_t> Impairment::get_delays_us()
+{
+	std::vector<uint64_t> delays;
+	++statistics.datagrams;
+
+	if (is_lost()) {
+		++statistics.dropped;
+		return delays;
+	}
+
+	uint64_t delay = get_delay_us();
+	if (uniform(generator) < parameters.reorder) {
+		/** Held back long enough for the following datagrams to overtake it */
+		delay += REORDER_DELAY_MS * 1000;
+		++statistics.reordered;
+	}
+	delays.push_back(delay);
+
+	if (uniform(generator) < parameters.duplicate) {
+		delays.push_back(get_delay_us());
+		++statistics.duplicated;
+	}
+
+	return delays;
+}
+
+const Impairment::Statistics &Impairment::get_statistics() const
+{
+	return statistics;
+}
+
+bool Impairment::is_lost()
+{
+	if (parameters.burst_length < 1)
+		return uniform(generator) < parameters.loss;
+
+	if (in_burst)
+		in_burst = uniform(generator) >= 1 / parameters.burst_length;
+	else
+		in_burst = uniform(generator) < parameters.loss;
+	return in_burst;
+}
+
+uint64_t Impairment::get_delay_us()
+{
+	return (uint64_t) ((parameters.delay_ms + uniform(generator) * parameters.jitter_ms) * 1000);
+}
@@ -0,0 +1,60 @@
+#ifndef IMPAIRMENT_H
+#define IMPAIRMENT_H
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/**
+ * Decides the fate of the datagrams going one way through the proxy.
+ *
+ * Losses are independent, or come in bursts (Gilbert-Elliott model) when a mean
+ * burst length is set: the loss probability is then the probability of a burst
+ * starting. Every decision is taken from a seeded generator, so the same seed
+ * and the same sequence of datagrams give the same impairments.
+ */
+class Impairment
+{
+public:
+	struct Parameters {
+		double loss;
+		double burst_length;
+		double reorder;
+		double duplicate;
+		double delay_ms;
+		double jitter_ms;
+	};
+
+	struct Statistics {
+		uint64_t datagrams;
+		uint64_t dropped;
+		uint64_t reordered;
+		uint64_t duplicated;
+	};
+
+	Impairment(const Parameters &parameters, uint32_t seed);
+
+	/**
+	 * Returns the delays (in microseconds) after which copies of the datagram
+	 * are to be delivered, empty when it is dropped.
+	 */
+	std::vector<uint64_t> get_delays_us();
+
+	const Statistics &get_statistics() const;
+
+	static const uint REORDER_DELAY_MS = 10;
+
+private:
+	bool is_lost();
+	uint64_t get_delay_us();
+
+	Parameters parameters;
+	std::mt19937 generator;
+	std::uniform_real_distribution<double> uniform;
+
+	bool in_burst;
+
+	Statistics statistics;
+};
+
+#endif // IMPAIRMENT_H
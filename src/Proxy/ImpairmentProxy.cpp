@@ -0,0 +1,266 @@
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <iostream>
+
+#include "Proxy/ImpairmentProxy.h"
+#include "System/Logging.h"
+#include "System/Utils.h"
+
+/**
+ * \class ImpairmentProxy
+ */
+
+const uint ImpairmentProxy::REPORT_INTERVAL_MS;
+
+ImpairmentProxy::ImpairmentProxy() :
+	listen_port(EM::Default::PROXY_PORT),
+	port(EM::Default::PORT),
+
+	parameters(),
+	seed(EM::Default::PROXY_SEED),
+
+	io_service(),
+	tcp_acceptor(nullptr),
+	udp_socket(nullptr),
+
+	sequence(0),
+	send_timer(io_service),
+	report_timer(io_service)
+{}
+
+void ImpairmentProxy::set_listen_port(uint listen_port)
+{
+	this->listen_port = listen_port;
+}
+
+uint ImpairmentProxy::get_listen_port() const
+{
+	return listen_port;
+}
+
+void ImpairmentProxy::set_port(uint port)
+{
+	this->port = port;
+}
+
+uint ImpairmentProxy::get_port() const
+{
+	return port;
+}
+
+void ImpairmentProxy::set_server_name(const std::string &server_name)
+{
+	this->server_name = server_name;
+}
+
+std::string ImpairmentProxy::get_server_name() const
+{
+	return server_name;
+}
+
+void ImpairmentProxy::set_parameters(const Impairment::Parameters &parameters)
+{
+	this->parameters = parameters;
+}
+
+const Impairment::Parameters &ImpairmentProxy::get_parameters() const
+{
+	return parameters;
+}
+
+void ImpairmentProxy::set_seed(uint seed)
+{
+	this->seed = seed;
+}
+
+uint ImpairmentProxy::get_seed() const
+{
+	return seed;
+}
+
+void ImpairmentProxy::start()
+{
+	std::string service = boost::lexical_cast<std::string>(get_port());
+
+	boost::asio::ip::tcp::resolver tcp_resolver(io_service);
+	tcp_server_endpoint =
+		*tcp_resolver.resolve({boost::asio::ip::tcp::v4(), get_server_name(), service});
+	boost::asio::ip::udp::resolver udp_resolver(io_service);
+	udp_server_endpoint =
+		*udp_resolver.resolve({boost::asio::ip::udp::v4(), get_server_name(), service});
+
+	upstream_impairment.reset(new Impairment(get_parameters(), get_seed()));
+	downstream_impairment.reset(new Impairment(get_parameters(), get_seed() + 1));
+
+	tcp_acceptor = new boost::asio::ip::tcp::acceptor(io_service,
+		boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), get_listen_port()));
+	udp_socket = new boost::asio::ip::udp::socket(io_service,
+		boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), get_listen_port()));
+
+	EM_WARN << "Proxying port " << get_listen_port() << " to " << udp_server_endpoint
+		<< " (loss " << parameters.loss * 100 << "%, burst " << parameters.burst_length
+		<< ", reorder " << parameters.reorder * 100 << "%, duplicate "
+		<< parameters.duplicate * 100 << "%, delay " << parameters.delay_ms << " ms, jitter "
+		<< parameters.jitter_ms << " ms, seed " << get_seed() << ").\n";
+
+	start_accept();
+	receive_routine();
+
+	report_timer.expires_from_now(boost::posix_time::milliseconds(REPORT_INTERVAL_MS));
+	report_timer.async_wait(boost::bind(&ImpairmentProxy::report_routine, this));
+
+	io_service.run();
+}
+
+void ImpairmentProxy::quit()
+{
+	io_service.stop();
+}
+
+ImpairmentProxy::Session::Session(boost::asio::io_service &io_service) :
+	upstream_socket(io_service, boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), 0))
+{}
+
+bool ImpairmentProxy::PendingDatagram::operator>(const PendingDatagram &other) const
+{
+	if (release != other.release)
+		return release > other.release;
+	return sequence > other.sequence;
+}
+
+void ImpairmentProxy::start_accept()
+{
+	TcpRelay::Pointer relay = TcpRelay::create(io_service);
+	tcp_acceptor->async_accept(relay->get_socket(),
+		boost::bind(&ImpairmentProxy::handle_accept, this, relay,
+			boost::asio::placeholders::error));
+}
+
+void ImpairmentProxy::handle_accept(
+	TcpRelay::Pointer relay,
+	const boost::system::error_code &error)
+{
+	if (error)
+		EM_WARN << "handle_accept: error\n";
+	else
+		relay->start(tcp_server_endpoint);
+	start_accept();
+}
+
+void ImpairmentProxy::receive_routine()
+{
+	udp_socket->async_receive_from(boost::asio::buffer(buffer), client_endpoint,
+		boost::bind(&ImpairmentProxy::handle_receive, this,
+			boost::asio::placeholders::error,
+			boost::asio::placeholders::bytes_transferred));
+}
+
+void ImpairmentProxy::handle_receive(const boost::system::error_code &error, size_t length)
+{
+	if (error) {
+		EM_WARN << "ImpairmentProxy: error in udp\n";
+	} else {
+		auto it = sessions.find(client_endpoint);
+		if (it == sessions.end()) {
+			Session *session = new Session(io_service);
+			session->client_endpoint = client_endpoint;
+			it = sessions.insert({client_endpoint, std::unique_ptr<Session>(session)}).first;
+
+			EM_INFO << "New UDP session for " << client_endpoint << " via port "
+				<< session->upstream_socket.local_endpoint().port() << ".\n";
+			upstream_receive_routine(session);
+		}
+
+		schedule(*upstream_impairment, buffer.data(), length, it->second.get(), true);
+	}
+	receive_routine();
+}
+
+void ImpairmentProxy::upstream_receive_routine(Session *session)
+{
+	session->upstream_socket.async_receive(boost::asio::buffer(session->buffer),
+		boost::bind(&ImpairmentProxy::handle_upstream_receive, this, session,
+			boost::asio::placeholders::error,
+			boost::asio::placeholders::bytes_transferred));
+}
+
+void ImpairmentProxy::handle_upstream_receive(
+	Session *session,
+	const boost::system::error_code &error,
+	size_t length)
+{
+	if (error)
+		EM_WARN << "ImpairmentProxy: error in upstream udp\n";
+	else
+		schedule(*downstream_impairment, session->buffer.data(), length, session, false);
+	upstream_receive_routine(session);
+}
+
+void ImpairmentProxy::schedule(
+	Impairment &impairment,
+	const char *data,
+	size_t length,
+	Session *session,
+	bool upstream)
+{
+	Clock::time_point now = Clock::now();
+	bool earliest = false;
+
+	for (uint64_t delay : impairment.get_delays_us()) {
+		PendingDatagram datagram {
+			now + std::chrono::microseconds(delay), sequence++,
+			std::string(data, length), session, upstream};
+		earliest |= pending.empty() || datagram.release < pending.top().release;
+		pending.push(datagram);
+	}
+
+	if (earliest)
+		send_routine();
+}
+
+void ImpairmentProxy::send_routine()
+{
+	Clock::time_point now = Clock::now();
+	boost::system::error_code error;
+
+	while (!pending.empty() && pending.top().release <= now) {
+		const PendingDatagram &datagram = pending.top();
+		if (datagram.upstream)
+			datagram.session->upstream_socket.send_to(boost::asio::buffer(datagram.data),
+				udp_server_endpoint, 0, error);
+		else
+			udp_socket->send_to(boost::asio::buffer(datagram.data),
+				datagram.session->client_endpoint, 0, error);
+		if (error)
+			EM_LOG << "ImpairmentProxy: unable to send.\n";
+		pending.pop();
+	}
+
+	if (pending.empty())
+		return;
+
+	send_timer.expires_from_now(boost::posix_time::microseconds(
+		std::chrono::duration_cast<std::chrono::microseconds>(
+			pending.top().release - now).count()));
+	send_timer.async_wait([this](const boost::system::error_code &error) {
+		if (error != boost::asio::error::operation_aborted)
+			send_routine();
+	});
+}
+
+void ImpairmentProxy::report_routine()
+{
+	report_timer.expires_at(report_timer.expires_at()
+		+ boost::posix_time::milliseconds(REPORT_INTERVAL_MS));
+	report_timer.async_wait(boost::bind(&ImpairmentProxy::report_routine, this));
+
+	for (int i = 0; i < 2; ++i) {
+		const Impairment::Statistics &s =
+			(i == 0 ? upstream_impairment : downstream_impairment)->get_statistics();
+		std::cout << (i == 0 ? "upstream:   " : "downstream: ")
+		          << s.datagrams << " datagrams, " << s.dropped << " dropped, "
+		          << s.reordered << " reordered, " << s.duplicated << " duplicated\n";
+	}
+	std::cout << "sessions: " << sessions.size() << ", in flight: " << pending.size()
+	          << "\n" << std::flush;
+}
@@ -0,0 +1,115 @@
+#ifndef IMPAIRMENTPROXY_H
+#define IMPAIRMENTPROXY_H
+
+#include <boost/array.hpp>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "Proxy/Impairment.h"
+#include "Proxy/TcpRelay.h"
+
+/**
+ * Sits between the clients and the server on one port, relaying TCP unchanged
+ * and passing UDP through an Impairment in each direction.
+ *
+ * Every client endpoint gets its own upstream socket, so the server still
+ * tells the clients apart.
+ */
+class ImpairmentProxy
+{
+public:
+	ImpairmentProxy();
+
+	void set_listen_port(uint listen_port);
+	uint get_listen_port() const;
+	void set_port(uint port);
+	uint get_port() const;
+	void set_server_name(const std::string &server_name);
+	std::string get_server_name() const;
+
+	void set_parameters(const Impairment::Parameters &parameters);
+	const Impairment::Parameters &get_parameters() const;
+	void set_seed(uint seed);
+	uint get_seed() const;
+
+	void start();
+	void quit();
+
+private:
+	typedef std::chrono::steady_clock Clock;
+	typedef boost::array<char, 65536> Buffer;
+
+	struct Session {
+		boost::asio::ip::udp::endpoint client_endpoint;
+		boost::asio::ip::udp::socket upstream_socket;
+		Buffer buffer;
+
+		Session(boost::asio::io_service &io_service);
+	};
+
+	struct PendingDatagram {
+		Clock::time_point release;
+		uint64_t sequence;
+		std::string data;
+		Session *session;
+		bool upstream;
+
+		bool operator>(const PendingDatagram &other) const;
+	};
+
+	/** TCP */
+
+	void start_accept();
+	void handle_accept(TcpRelay::Pointer relay, const boost::system::error_code &error);
+
+	/** UDP */
+
+	void receive_routine();
+	void handle_receive(const boost::system::error_code &error, size_t length);
+	void upstream_receive_routine(Session *session);
+	void handle_upstream_receive(
+		Session *session,
+		const boost::system::error_code &error,
+		size_t length);
+
+	void schedule(Impairment &impairment, const char *data, size_t length,
+		Session *session, bool upstream);
+	void send_routine();
+	void report_routine();
+
+	uint listen_port;
+	uint port;
+	std::string server_name;
+
+	Impairment::Parameters parameters;
+	uint seed;
+
+	boost::asio::io_service io_service;
+	boost::asio::ip::tcp::acceptor *tcp_acceptor;
+	boost::asio::ip::tcp::endpoint tcp_server_endpoint;
+
+	boost::asio::ip::udp::socket *udp_socket;
+	boost::asio::ip::udp::endpoint udp_server_endpoint;
+	boost::asio::ip::udp::endpoint client_endpoint;
+	Buffer buffer;
+
+	std::map<boost::asio::ip::udp::endpoint, std::unique_ptr<Session> > sessions;
+
+	std::unique_ptr<Impairment> upstream_impairment;
+	std::unique_ptr<Impairment> downstream_impairment;
+
+	std::priority_queue<PendingDatagram, std::vector<PendingDatagram>,
+		std::greater<PendingDatagram> > pending;
+	uint64_t sequence;
+	boost::asio::deadline_timer send_timer;
+	boost::asio::deadline_timer report_timer;
+
+	static const uint REPORT_INTERVAL_MS = 5000;
+};
+
+#endif // IMPAIRMENTPROXY_H
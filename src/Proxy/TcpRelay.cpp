@@ -0,0 +1,93 @@
+#include <boost/bind.hpp>
+
+#include "Proxy/TcpRelay.h"
+#include "System/Logging.h"
+
+/**
+ * \class TcpRelay
+ */
+
+TcpRelay::Pointer TcpRelay::create(boost::asio::io_service &io_service)
+{
+	return Pointer(new TcpRelay(io_service));
+}
+
+boost::asio::ip::tcp::socket &TcpRelay::get_socket()
+{
+	return client_socket;
+}
+
+void TcpRelay::start(const boost::asio::ip::tcp::endpoint &server_endpoint)
+{
+	server_socket.async_connect(server_endpoint,
+		boost::bind(&TcpRelay::handle_connect, shared_from_this(),
+			boost::asio::placeholders::error));
+}
+
+TcpRelay::TcpRelay(boost::asio::io_service &io_service) :
+	client_socket(io_service),
+	server_socket(io_service)
+{}
+
+void TcpRelay::handle_connect(const boost::system::error_code &error)
+{
+	if (error) {
+		EM_WARN << "TcpRelay: unable to connect to the server.\n";
+		close();
+		return;
+	}
+
+	read_routine(client_socket, server_socket, client_buffer);
+	read_routine(server_socket, client_socket, server_buffer);
+}
+
+void TcpRelay::read_routine(
+	boost::asio::ip::tcp::socket &from,
+	boost::asio::ip::tcp::socket &to,
+	Buffer &buffer)
+{
+	from.async_read_some(boost::asio::buffer(buffer),
+		boost::bind(&TcpRelay::handle_read, shared_from_this(),
+			boost::ref(from), boost::ref(to), boost::ref(buffer),
+			boost::asio::placeholders::error,
+			boost::asio::placeholders::bytes_transferred));
+}
+
+void TcpRelay::handle_read(
+	boost::asio::ip::tcp::socket &from,
+	boost::asio::ip::tcp::socket &to,
+	Buffer &buffer,
+	const boost::system::error_code &error,
+	size_t length)
+{
+	if (error) {
+		close();
+		return;
+	}
+
+	boost::asio::async_write(to, boost::asio::buffer(buffer, length),
+		boost::bind(&TcpRelay::handle_write, shared_from_this(),
+			boost::ref(from), boost::ref(to), boost::ref(buffer),
+			boost::asio::placeholders::error));
+}
+
+void TcpRelay::handle_write(
+	boost::asio::ip::tcp::socket &from,
+	boost::asio::ip::tcp::socket &to,
+	Buffer &buffer,
+	const boost::system::error_code &error)
+{
+	if (error) {
+		close();
+		return;
+	}
+
+	read_routine(from, to, buffer);
+}
+
+void TcpRelay::close()
+{
+	boost::system::error_code ignored;
+	client_socket.close(ignored);
+	server_socket.close(ignored);
+}
@@ -0,0 +1,42 @@
+#ifndef TCPRELAY_H
+#define TCPRELAY_H
+
+#include <boost/array.hpp>
+#include <boost/asio.hpp>
+#include <boost/enable_shared_from_this.hpp>
+
+/**
+ * Copies a TCP connection both ways between a client and the server, unchanged.
+ */
+class TcpRelay : public boost::enable_shared_from_this<TcpRelay>
+{
+public:
+	typedef boost::shared_ptr<TcpRelay> Pointer;
+
+	static Pointer create(boost::asio::io_service &io_service);
+
+	boost::asio::ip::tcp::socket &get_socket();
+	void start(const boost::asio::ip::tcp::endpoint &server_endpoint);
+
+private:
+	TcpRelay(boost::asio::io_service &io_service);
+
+	typedef boost::array<char, 4096> Buffer;
+
+	void handle_connect(const boost::system::error_code &error);
+	void read_routine(boost::asio::ip::tcp::socket &from, boost::asio::ip::tcp::socket &to,
+		Buffer &buffer);
+	void handle_read(boost::asio::ip::tcp::socket &from, boost::asio::ip::tcp::socket &to,
+		Buffer &buffer, const boost::system::error_code &error, size_t length);
+	void handle_write(boost::asio::ip::tcp::socket &from, boost::asio::ip::tcp::socket &to,
+		Buffer &buffer, const boost::system::error_code &error);
+	void close();
+
+	boost::asio::ip::tcp::socket client_socket;
+	boost::asio::ip::tcp::socket server_socket;
+
+	Buffer client_buffer;
+	Buffer server_buffer;
+};
+
+#endif // TCPRELAY_H
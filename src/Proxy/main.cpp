@@ -0,0 +1,86 @@
+#include <iostream>
+
+#include "Proxy/ImpairmentProxy.h"
+#include "System/ArgsManager.h"
+#include "System/Error.h"
+#include "System/Logging.h"
+#include "System/SignalHandler.h"
+#include "System/Strings.h"
+
+ImpairmentProxy *proxy_ptr;
+
+void quit()
+{
+	proxy_ptr->quit();
+}
+
+int main(int argc, char **argv)
+{
+	ArgsManager args_manager(argc - 1, argv + 1);
+
+	ImpairmentProxy proxy;
+	proxy_ptr = &proxy;
+
+	SignalHandler::setup((int) SIGINT, quit);
+
+	Impairment::Parameters parameters = Impairment::Parameters();
+
+	while (!args_manager.finished()) {
+		switch (args_manager.get_arg()) {
+			case EM::Arg::Help:
+				std::cout << EM::Strings::Proxy::HelpMessage;
+				return EXIT_SUCCESS;
+
+			case EM::Arg::Port:
+				proxy.set_port(args_manager.get_uint());
+				break;
+			case EM::Arg::ServerName:
+				proxy.set_server_name(args_manager.get_string());
+				break;
+			case EM::Arg::ProxyPort:
+				proxy.set_listen_port(args_manager.get_uint());
+				break;
+
+			case EM::Arg::Loss:
+				parameters.loss = args_manager.get_double() / 100;
+				break;
+			case EM::Arg::BurstLength:
+				parameters.burst_length = args_manager.get_double();
+				break;
+			case EM::Arg::Reorder:
+				parameters.reorder = args_manager.get_double() / 100;
+				break;
+			case EM::Arg::Duplicate:
+				parameters.duplicate = args_manager.get_double() / 100;
+				break;
+			case EM::Arg::Delay:
+				parameters.delay_ms = args_manager.get_double();
+				break;
+			case EM::Arg::Jitter:
+				parameters.jitter_ms = args_manager.get_double();
+				break;
+			case EM::Arg::Seed:
+				proxy.set_seed(args_manager.get_uint());
+				break;
+
+			case EM::Arg::Verbosity:
+				EM::Logging::set_level(args_manager.get_uint());
+				break;
+
+			default:
+				std::cerr << EM::Errors::to_string(EM::Error::UnknownArg) << ": "
+				          << args_manager.get_previous_arg() << "\n";
+				return EXIT_SUCCESS;
+		}
+	}
+
+	if (!args_manager.arg_set(EM::Arg::ServerName)) {
+		std::cerr << EM::Errors::to_string(EM::Error::NoServerName) << "\n";
+		return EXIT_SUCCESS;
+	}
+
+	proxy.set_parameters(parameters);
+	proxy.start();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+#include <csignal>
+#include <iostream>
+
+#include "Server/EMServer.h"
+#include "System/ArgsManager.h"
+#include "System/Error.h"
+#include "System/Logging.h"
+#include "System/SignalHandler.h"
+#include "System/Strings.h"
+#include "System/Utils.h"
+
+EMServer *em_server_ptr;
+
+void quit()
+{
+	em_server_ptr->request_stop();
+}
+
+int main(int argc, char **argv)
+{
+	ArgsManager args_manager(argc - 1, argv + 1);
+
+	EMServer em_server;
+	em_server_ptr = &em_server;
+
+	SignalHandler::setup((int) SIGINT, quit);
+
+	std::string trace_path;
+	bool max_speed = false;
+
+	while (!args_manager.finished()) {
+		switch (args_manager.get_arg()) {
+			case EM::Arg::Help:
+				std::cout << EM::Strings::Replay::HelpMessage;
+				return EXIT_SUCCESS;
+
+			case EM::Arg::Trace:
+				trace_path = args_manager.get_string();
+				break;
+			case EM::Arg::MaxSpeed:
+				max_speed = true;
+				break;
+
+			case EM::Arg::FifoSize:
+				em_server.set_fifo_size(args_manager.get_uint());
+				break;
+			case EM::Arg::FifoLowWatermark:
+				em_server.set_fifo_low_watermark(args_manager.get_uint());
+				break;
+			case EM::Arg::FifoHighWatermark:
+				em_server.set_fifo_high_watermark(args_manager.get_uint());
+				break;
+
+			case EM::Arg::BufferLength:
+				em_server.set_buffer_length(args_manager.get_uint());
+				break;
+
+			case EM::Arg::TxInterval:
+				em_server.set_tx_interval(args_manager.get_uint());
+				break;
+			case EM::Arg::MaxTxInterval:
+				em_server.set_max_tx_interval(args_manager.get_uint());
+				break;
+
+			case EM::Arg::MaxSpeakers:
+				em_server.set_max_speakers(args_manager.get_uint());
+				break;
+			case EM::Arg::MixerThreads:
+				em_server.set_mixer_threads(args_manager.get_uint());
+				break;
+			case EM::Arg::Record:
+				em_server.set_record_path(args_manager.get_string());
+				break;
+
+			case EM::Arg::Verbosity:
+				EM::Logging::set_level(args_manager.get_uint());
+				break;
+
+			default:
+				std::cerr << EM::Errors::to_string(EM::Error::UnknownArg) << ": "
+				          << args_manager.get_previous_arg() << "\n";
+				return EXIT_SUCCESS;
+		}
+	}
+
+	if (!args_manager.arg_set(EM::Arg::Trace)) {
+		std::cerr << EM::Errors::to_string(EM::Error::NoTrace) << "\n";
+		return EXIT_SUCCESS;
+	}
+
+	em_server.replay(trace_path, max_speed);
+	em_server.quit();
+	EM::Logging::flush();
+
+	return EXIT_SUCCESS;
+}
@@ -3,6 +3,7 @@
 
 #include "Server/ClientObject.h"
 #include "System/Messages.h"
+#include "System/Utils.h"
 
 /**
  * \class ClientQueue
@@ -18,10 +19,16 @@ ClientQueue::ClientQueue(
 	fifo_high_watermark(fifo_high_watermark),
 
 	bytes_inserted(0),
+	bytes_moved(0),
+
+	residency_histogram(nullptr),
 
 	recent_min(0),
 	recent_max(0),
 
+	drift_min(0),
+	drift_max(0),
+
 	nr(0),
 
 	state(State::Filling)
@@ -40,6 +47,8 @@ bool ClientQueue::insert(const std::string &input, uint nr)
 	buffer += input;
 	update_recent_data();
 	bytes_inserted += input.length();
+	if (residency_histogram != nullptr)
+		insert_times.push_back({bytes_inserted, std::chrono::steady_clock::now()});
 	if (get_size() >= fifo_high_watermark)
 		state = State::Active;
 	this->nr = nr;
@@ -47,6 +56,11 @@ bool ClientQueue::insert(const std::string &input, uint nr)
 	return true;
 }
 
+bool ClientQueue::is_new(uint nr) const
+{
+	return nr > this->nr || nr == 0;
+}
+
 std::string ClientQueue::get(size_t length)
 {
 	std::string data = buffer.substr(0, length);
@@ -58,6 +72,20 @@ bool ClientQueue::move(size_t length)
 	if (length > buffer.size())
 		return false;
 	buffer = buffer.substr(length);
+	bytes_moved += length;
+
+	if (!insert_times.empty()) {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		while (!insert_times.empty() && insert_times.front().first <= bytes_moved) {
+			residency_histogram->record(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(
+					now - insert_times.front().second).count());
+			insert_times.pop_front();
+		}
+	}
+
+	drift_min = std::min(drift_min, get_size());
+
 	if (get_size() <= fifo_low_watermark)
 		state = State::Filling;
 	return true;
@@ -71,8 +99,14 @@ bool ClientQueue::is_full() const
 void ClientQueue::clear()
 {
 	bytes_inserted = 0;
+	bytes_moved    = 0;
 	recent_min     = 0;
 	recent_max     = 0;
+	drift_min      = 0;
+	drift_max      = 0;
+	nr             = 0;
+	state          = State::Filling;
+	insert_times.clear();
 	buffer.clear();
 }
 
@@ -111,11 +145,28 @@ void ClientQueue::reset_recent_data()
 	recent_min = recent_max = get_size();
 }
 
+void ClientQueue::take_drift_window(size_t &min_size, size_t &max_size)
+{
+	min_size = drift_min;
+	max_size = drift_max;
+	drift_min = drift_max = get_size();
+}
+
+size_t ClientQueue::get_target_size() const
+{
+	return (fifo_low_watermark + fifo_high_watermark) / 2;
+}
+
 uint ClientQueue::get_expected_nr() const
 {
 	return nr + 1;
 }
 
+void ClientQueue::set_residency_histogram(Histogram *residency_histogram)
+{
+	this->residency_histogram = residency_histogram;
+}
+
 ClientQueue::State ClientQueue::get_state() const
 {
 	return state;
@@ -135,12 +186,16 @@ void ClientQueue::update_recent_data()
 {
 	recent_min = std::min(recent_min, get_size());
 	recent_max = std::max(recent_max, get_size());
+	drift_min  = std::min(drift_min, get_size());
+	drift_max  = std::max(drift_max, get_size());
 }
 
 /**
  * \class ClientObject
  */
 
+const uint ClientObject::ENERGY_SMOOTHING;
+
 ClientObject::ClientObject(
 	uint cid,
 	size_t fifo_size,
@@ -148,9 +203,47 @@ ClientObject::ClientObject(
 	size_t fifo_high_watermark) :
 
 	cid(cid),
-	queue(fifo_size, fifo_low_watermark, fifo_high_watermark)
+	queue(fifo_size, fifo_low_watermark, fifo_high_watermark),
+
+	rate(EM::Default::SAMPLE_RATE),
+	channels(EM::Default::CHANNELS),
+	resampler(nullptr),
+	drift_compensator(queue.get_target_size(), queue.get_max_size()),
+
+	last_activity(std::chrono::steady_clock::now()),
+
+	energy(0),
+	speaking(false),
+
+	trunk(false),
+	multicast(false),
+
+	token(0),
+	detached(false)
 {}
 
+void ClientObject::reset(uint cid)
+{
+	this->cid = cid;
+	queue.clear();
+
+	rate     = EM::Default::SAMPLE_RATE;
+	channels = EM::Default::CHANNELS;
+	resampler.reset();
+	drift_compensator.reset();
+
+	set_connection(TcpConnection::Pointer(nullptr));
+	token    = 0;
+	detached = false;
+	udp_endpoint = boost::asio::ip::udp::endpoint();
+	touch();
+
+	energy    = 0;
+	speaking  = false;
+	trunk     = false;
+	multicast = false;
+}
+
 uint ClientObject::get_cid() const
 {
 	return cid;
@@ -173,18 +266,38 @@ std::string ClientObject::get_name() const
 
 void ClientObject::set_connection(TcpConnection::Pointer connection)
 {
-	this->connection = connection;
+	boost::atomic_store(&this->connection, connection);
 }
 
 TcpConnection::Pointer ClientObject::get_connection()
 {
-	return connection;
+	return boost::atomic_load(&connection);
 }
 
 bool ClientObject::is_connected() const
 {
-	return connection != nullptr && get_name() != "0.0.0.0:0" &&
-		get_name() != "00:00:00:00:00:00:0";
+	return (boost::atomic_load(&connection) != nullptr || detached)
+		&& get_name() != "0.0.0.0:0" && get_name() != "00:00:00:00:00:00:0";
+}
+
+void ClientObject::set_token(uint64_t token)
+{
+	this->token = token;
+}
+
+uint64_t ClientObject::get_token() const
+{
+	return token;
+}
+
+void ClientObject::set_detached(bool detached)
+{
+	this->detached = detached;
+}
+
+bool ClientObject::is_detached() const
+{
+	return detached;
 }
 
 std::string ClientObject::get_report()
@@ -209,3 +322,138 @@ boost::asio::ip::udp::endpoint ClientObject::get_udp_endpoint()
 {
 	return udp_endpoint;
 }
+
+void ClientObject::touch()
+{
+	touch(std::chrono::steady_clock::now());
+}
+
+void ClientObject::touch(std::chrono::steady_clock::time_point time)
+{
+	last_activity = time;
+}
+
+std::chrono::steady_clock::time_point ClientObject::get_last_activity() const
+{
+	return last_activity;
+}
+
+void ClientObject::set_format(uint rate, uint channels)
+{
+	if (rate == this->rate && channels == this->channels)
+		return;
+
+	this->rate     = rate;
+	this->channels = channels;
+
+	resampler.reset(new Resampler(rate, channels,
+		EM::Default::SAMPLE_RATE, EM::Default::CHANNELS));
+	resampler->set_ratio_adjustment(drift_compensator.get_ratio_adjustment());
+}
+
+uint ClientObject::get_rate() const
+{
+	return rate;
+}
+
+uint ClientObject::get_channels() const
+{
+	return channels;
+}
+
+std::string ClientObject::convert(const std::string &data)
+{
+	if (resampler == nullptr)
+		return data;
+	return resampler->process(data);
+}
+
+bool ClientObject::insert_upload(const std::string &data, uint nr)
+{
+	if (resampler == nullptr)
+		return queue.insert(data, nr);
+
+	/** A rejected datagram comes again, it must meet the filter as if for the first time */
+	std::string output = resampler->prepare(data);
+	if (!queue.is_new(nr) || output.length() > queue.get_available_space_size())
+		return false;
+
+	/** Even when too short for any output, the input is held for the next one */
+	resampler->commit();
+	return queue.insert(output, nr);
+}
+
+void ClientObject::compensate_drift()
+{
+	size_t min_size, max_size;
+	queue.take_drift_window(min_size, max_size);
+
+	/** The level means nothing while the queue refills or sits idle */
+	if (!queue.is_active())
+		return;
+
+	drift_compensator.update(min_size, max_size);
+	double ratio_adjustment = drift_compensator.get_ratio_adjustment();
+
+	if (resampler == nullptr) {
+		if (ratio_adjustment == 1.0)
+			return;
+		resampler.reset(new Resampler(rate, channels,
+			EM::Default::SAMPLE_RATE, EM::Default::CHANNELS));
+	}
+	resampler->set_ratio_adjustment(ratio_adjustment);
+}
+
+void ClientObject::update_energy(uint64_t energy)
+{
+	this->energy = this->energy - this->energy / ENERGY_SMOOTHING + energy / ENERGY_SMOOTHING;
+}
+
+uint64_t ClientObject::get_energy() const
+{
+	return energy;
+}
+
+void ClientObject::set_speaking(bool speaking)
+{
+	this->speaking = speaking;
+}
+
+bool ClientObject::is_speaking() const
+{
+	return speaking;
+}
+
+void ClientObject::set_trunk(bool trunk)
+{
+	this->trunk = trunk;
+}
+
+bool ClientObject::is_trunk() const
+{
+	return trunk;
+}
+
+void ClientObject::set_multicast(bool multicast)
+{
+	this->multicast = multicast;
+}
+
+bool ClientObject::is_multicast() const
+{
+	return multicast;
+}
+
+double ClientObject::get_ratio_adjustment() const
+{
+	return drift_compensator.get_ratio_adjustment();
+}
+
+size_t ClientObject::get_window() const
+{
+	size_t window = queue.get_available_space_size();
+	if (rate == EM::Default::SAMPLE_RATE && channels == EM::Default::CHANNELS)
+		return window;
+	return (size_t) ((uint64_t) window * rate * channels
+		/ (EM::Default::SAMPLE_RATE * EM::Default::CHANNELS));
+}
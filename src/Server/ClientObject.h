@@ -2,9 +2,15 @@
 #define CLIENTOBJECT_H
 
 #include <cctype>
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <string>
 
+#include "Server/DriftCompensator.h"
+#include "Server/Resampler.h"
 #include "Server/TcpConnection.h"
+#include "System/Histogram.h"
 
 class ClientQueue
 {
@@ -12,6 +18,7 @@ public:
 	ClientQueue(size_t fifo_size, size_t fifo_low_watermark, size_t fifo_high_watermark);
 
 	bool insert(const std::string &data, uint nr);
+	bool is_new(uint nr) const;
 	std::string get(size_t length);
 	bool move(size_t length);
 	bool is_full() const;
@@ -26,8 +33,14 @@ public:
 	size_t get_max_recent_bytes() const;
 	void reset_recent_data();
 
+	/** Fill level range since the previous call, resets it */
+	void take_drift_window(size_t &min_size, size_t &max_size);
+	size_t get_target_size() const;
+
 	uint get_expected_nr() const;
 
+	void set_residency_histogram(Histogram *residency_histogram);
+
 	enum class State : uint8_t {Active, Filling};
 
 	State get_state() const;
@@ -42,10 +55,18 @@ private:
 	size_t fifo_high_watermark;
 
 	size_t bytes_inserted;
+	size_t bytes_moved;
+
+	/** End offsets (in bytes_inserted) of the inserted chunks with their insert times */
+	std::deque<std::pair<size_t, std::chrono::steady_clock::time_point> > insert_times;
+	Histogram *residency_histogram;
 
 	size_t recent_min;
 	size_t recent_max;
 
+	size_t drift_min;
+	size_t drift_max;
+
 	uint nr;
 
 	State state;
@@ -62,6 +83,9 @@ public:
 		size_t fifo_low_watermark,
 		size_t fifo_high_watermark);
 
+	/** Makes a released object good as new for another client, keeping its memory */
+	void reset(uint cid);
+
 	uint get_cid() const;
 	ClientQueue &get_queue();
 
@@ -73,15 +97,76 @@ public:
 	TcpConnection::Pointer get_connection();
 	bool is_connected() const;
 
+	/** Issued with the cid, the client proves with it that a session is its own */
+	void set_token(uint64_t token);
+	uint64_t get_token() const;
+
+	/** Lost its TCP connection, still mixed while it has a chance to resume */
+	void set_detached(bool detached);
+	bool is_detached() const;
+
 	std::string get_report();
 
 	void set_udp_endpoint(boost::asio::ip::udp::endpoint udp_endpoint);
 	boost::asio::ip::udp::endpoint get_udp_endpoint();
 
+	/** Marks the client as heard from, now or at the given time */
+	void touch();
+	void touch(std::chrono::steady_clock::time_point time);
+	std::chrono::steady_clock::time_point get_last_activity() const;
+
+	/** Format of the uploaded data, converted to the room format on arrival */
+	void set_format(uint rate, uint channels);
+	uint get_rate() const;
+	uint get_channels() const;
+
+	std::string convert(const std::string &data);
+	/** Converts and queues an upload; the resampler moves on only if the queue takes it */
+	bool insert_upload(const std::string &data, uint nr);
+
+	/** Speaker selection, the energy is smoothed over a few ticks */
+	void update_energy(uint64_t energy);
+	uint64_t get_energy() const;
+	void set_speaking(bool speaking);
+	bool is_speaking() const;
+
+	static const uint ENERGY_SMOOTHING = 16;
+
+	/** Another server, sent the mix without its own upload */
+	void set_trunk(bool trunk);
+	bool is_trunk() const;
+
+	/** Joined the multicast group, gets the mix from there and only ACK from here */
+	void set_multicast(bool multicast);
+	bool is_multicast() const;
+
+	/** Nudges the conversion ratio to keep the queue near its target size */
+	void compensate_drift();
+	double get_ratio_adjustment() const;
+	/** Available queue space in the client's own bytes */
+	size_t get_window() const;
+
 private:
 	uint cid;
 	ClientQueue queue;
 
+	uint rate;
+	uint channels;
+	std::unique_ptr<Resampler> resampler;
+	DriftCompensator drift_compensator;
+
+	std::chrono::steady_clock::time_point last_activity;
+
+	uint64_t energy;
+	bool speaking;
+
+	bool trunk;
+	bool multicast;
+
+	uint64_t token;
+	bool detached;
+
+	/** Swapped atomically, the report thread reads it too */
 	TcpConnection::Pointer connection;
 	boost::asio::ip::udp::endpoint udp_endpoint;
 };
@@ -0,0 +1,59 @@
+#include "Server/ClientPool.h"
+
+/**
+ * \class ClientPool
+ */
+
+const size_t ClientPool::SLAB_SIZE;
+
+ClientPool::ClientPool(
+	size_t fifo_size,
+	size_t fifo_low_watermark,
+	size_t fifo_high_watermark) :
+
+	fifo_size(fifo_size),
+	fifo_low_watermark(fifo_low_watermark),
+	fifo_high_watermark(fifo_high_watermark)
+{}
+
+ClientObject *ClientPool::acquire(uint cid)
+{
+	if (free_list.empty())
+		add_slab();
+
+	ClientObject *client = free_list.back();
+	free_list.pop_back();
+	client->reset(cid);
+	return client;
+}
+
+void ClientPool::release(ClientObject *client)
+{
+	/** Drop what the client holds on to right away, the memory stays */
+	client->reset(0);
+	free_list.push_back(client);
+}
+
+size_t ClientPool::get_allocated() const
+{
+	return slabs.size() * SLAB_SIZE;
+}
+
+size_t ClientPool::get_free() const
+{
+	return free_list.size();
+}
+
+void ClientPool::add_slab()
+{
+	/** Reserved up front, so the objects never move */
+	std::vector<ClientObject> *slab = new std::vector<ClientObject>();
+	slab->reserve(SLAB_SIZE);
+	for (size_t i = 0; i < SLAB_SIZE; ++i)
+		slab->emplace_back(0, fifo_size, fifo_low_watermark, fifo_high_watermark);
+	slabs.emplace_back(slab);
+
+	/** Reversed, so the first objects of the slab go out first */
+	for (size_t i = SLAB_SIZE; i > 0; --i)
+		free_list.push_back(&(*slab)[i - 1]);
+}
@@ -0,0 +1,40 @@
+#ifndef CLIENTPOOL_H
+#define CLIENTPOOL_H
+
+#include <memory>
+#include <vector>
+
+#include "Server/ClientObject.h"
+
+/**
+ * Hands out ClientObjects carved from slabs and takes them back for reuse, so a
+ * reconnecting client gets a recycled object and its FIFO instead of a fresh
+ * allocation. Objects are never freed before the pool.
+ *
+ * Used only from the io_service thread.
+ */
+class ClientPool
+{
+public:
+	ClientPool(size_t fifo_size, size_t fifo_low_watermark, size_t fifo_high_watermark);
+
+	ClientObject *acquire(uint cid);
+	void release(ClientObject *client);
+
+	size_t get_allocated() const;
+	size_t get_free() const;
+
+	static const size_t SLAB_SIZE = 16;
+
+private:
+	void add_slab();
+
+	size_t fifo_size;
+	size_t fifo_low_watermark;
+	size_t fifo_high_watermark;
+
+	std::vector<std::unique_ptr<std::vector<ClientObject> > > slabs;
+	std::vector<ClientObject *> free_list;
+};
+
+#endif // CLIENTPOOL_H
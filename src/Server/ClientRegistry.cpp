@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <atomic>
+
+#include "Server/ClientRegistry.h"
+
+/**
+ * \class ClientRegistry
+ */
+
+ClientRegistry::ClientRegistry() :
+	snapshot(std::make_shared<const Snapshot>()),
+	generation(0)
+{}
+
+void ClientRegistry::add(ClientObject *client)
+{
+	index[client->get_cid()] = client;
+	publish();
+}
+
+ClientObject *ClientRegistry::remove(uint cid)
+{
+	auto it = index.find(cid);
+	if (it == index.end())
+		return nullptr;
+
+	ClientObject *client = it->second;
+	index.erase(it);
+	retired.push_back({client, generation});
+	publish();
+	return client;
+}
+
+ClientObject *ClientRegistry::find(uint cid) const
+{
+	auto it = index.find(cid);
+	return it == index.end() ? nullptr : it->second;
+}
+
+std::vector<ClientObject *> ClientRegistry::reclaim()
+{
+	published.erase(std::remove_if(published.begin(), published.end(),
+		[](const std::pair<uint64_t, std::weak_ptr<const Snapshot> > &p) {
+			return p.second.expired();
+		}), published.end());
+
+	uint64_t oldest_alive = generation;
+	for (auto &p : published)
+		oldest_alive = std::min(oldest_alive, p.first);
+
+	std::vector<ClientObject *> reclaimed;
+	auto it = std::partition(retired.begin(), retired.end(),
+		[oldest_alive](const std::pair<ClientObject *, uint64_t> &p) {
+			return p.second >= oldest_alive;
+		});
+	for (auto r = it; r != retired.end(); ++r)
+		reclaimed.push_back(r->first);
+	retired.erase(it, retired.end());
+
+	return reclaimed;
+}
+
+size_t ClientRegistry::get_retired_number() const
+{
+	return retired.size();
+}
+
+ClientRegistry::SnapshotPointer ClientRegistry::get_snapshot() const
+{
+	return std::atomic_load(&snapshot);
+}
+
+void ClientRegistry::publish()
+{
+	std::shared_ptr<Snapshot> next = std::make_shared<Snapshot>();
+	next->reserve(index.size());
+	for (auto p : index)
+		next->push_back(p.second);
+
+	/** Ordered by cid, so the mixing order doesn't depend on the hashing */
+	std::sort(next->begin(), next->end(), [](ClientObject *a, ClientObject *b) {
+		return a->get_cid() < b->get_cid();
+	});
+
+	published.push_back({generation, snapshot});
+	++generation;
+	std::atomic_store(&snapshot, SnapshotPointer(next));
+}
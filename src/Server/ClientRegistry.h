@@ -0,0 +1,58 @@
+#ifndef CLIENTREGISTRY_H
+#define CLIENTREGISTRY_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "Server/ClientObject.h"
+
+/**
+ * The set of clients of a server.
+ *
+ * Written only by the io_service thread. Every change publishes a new immutable
+ * snapshot, which readers on any thread take without locking and iterate as a
+ * plain array. A snapshot stays valid for as long as the reader holds it.
+ *
+ * Removed clients are retired rather than forgotten, and handed back by reclaim()
+ * once no snapshot that still lists them is alive.
+ */
+class ClientRegistry
+{
+public:
+	typedef std::vector<ClientObject *> Snapshot;
+	typedef std::shared_ptr<const Snapshot> SnapshotPointer;
+
+	ClientRegistry();
+
+	/** Writer side */
+
+	void add(ClientObject *client);
+	/** Returns the retired client or nullptr */
+	ClientObject *remove(uint cid);
+	ClientObject *find(uint cid) const;
+
+	/** Retired clients no reader can see any more */
+	std::vector<ClientObject *> reclaim();
+	size_t get_retired_number() const;
+
+	/** Reader side, safe from any thread */
+
+	SnapshotPointer get_snapshot() const;
+
+private:
+	void publish();
+
+	std::unordered_map<uint, ClientObject *> index;
+	SnapshotPointer snapshot;
+
+	/** Generation of the current snapshot, older published ones that may be alive */
+	uint64_t generation;
+	std::vector<std::pair<uint64_t, std::weak_ptr<const Snapshot> > > published;
+
+	/** With the last generation that listed them */
+	std::vector<std::pair<ClientObject *, uint64_t> > retired;
+};
+
+#endif // CLIENTREGISTRY_H
@@ -0,0 +1,47 @@
+#include <algorithm>
+#include <cassert>
+
+#include "Server/DriftCompensator.h"
+
+/**
+ * \class DriftCompensator
+ */
+
+constexpr double DriftCompensator::MAX_ADJUSTMENT;
+constexpr double DriftCompensator::PROPORTIONAL;
+constexpr double DriftCompensator::INTEGRAL;
+
+DriftCompensator::DriftCompensator(size_t target_size, size_t max_size) :
+	target_size(target_size),
+	max_size(max_size),
+
+	integral(0),
+	ratio_adjustment(1.0)
+{
+	assert(max_size > 0);
+}
+
+void DriftCompensator::update(size_t min_size, size_t max_size)
+{
+	/** Relative distance of the window's middle from the target, in [-1, 1] */
+	double level = (min_size + max_size) / 2.0;
+	double error = (level - target_size) / this->max_size;
+
+	integral += INTEGRAL * error;
+	integral = std::max(-MAX_ADJUSTMENT, std::min(MAX_ADJUSTMENT, integral));
+
+	double adjustment = integral + PROPORTIONAL * error;
+	adjustment = std::max(-MAX_ADJUSTMENT, std::min(MAX_ADJUSTMENT, adjustment));
+	ratio_adjustment = 1.0 + adjustment;
+}
+
+void DriftCompensator::reset()
+{
+	integral         = 0;
+	ratio_adjustment = 1.0;
+}
+
+double DriftCompensator::get_ratio_adjustment() const
+{
+	return ratio_adjustment;
+}
@@ -0,0 +1,38 @@
+#ifndef DRIFTCOMPENSATOR_H
+#define DRIFTCOMPENSATOR_H
+
+#include <cstddef>
+
+/**
+ * Steers the resampling ratio of one client so that its FIFO stays near a target
+ * depth, compensating for the clock drift between the client's sound card and the
+ * server's mixer.
+ *
+ * Fed once per window with the lowest and highest fill levels seen in it. The
+ * correction is proportional plus integral, the integral part settles on the
+ * actual drift and the proportional part pulls the level back to the target.
+ */
+class DriftCompensator
+{
+public:
+	DriftCompensator(size_t target_size, size_t max_size);
+
+	void update(size_t min_size, size_t max_size);
+	void reset();
+
+	/** Above 1 when the client runs fast and more input has to be consumed */
+	double get_ratio_adjustment() const;
+
+	static constexpr double MAX_ADJUSTMENT = 0.002;
+	static constexpr double PROPORTIONAL   = 0.004;
+	static constexpr double INTEGRAL       = 0.0001;
+
+private:
+	size_t target_size;
+	size_t max_size;
+
+	double integral;
+	double ratio_adjustment;
+};
+
+#endif // DRIFTCOMPENSATOR_H
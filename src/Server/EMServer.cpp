@@ -1,6 +1,10 @@
+#include <algorithm>
 #include <boost/bind.hpp>
+#include <chrono>
+#include <functional>
 #include <iostream>
 #include <thread>
+#include <vector>
 
 #include "Server/EMServer.h"
 #include "System/Logging.h"
@@ -11,9 +15,26 @@
  * \class EMServer
  */
 
+const uint EMServer::MAX_MIXER_LAG;
+const uint EMServer::CLIENT_TIMEOUT_MS;
+const uint EMServer::RESUME_TIMEOUT_MS;
+const uint EMServer::SPEAKER_HYSTERESIS;
+const uint EMServer::HOUSEKEEPING_INTERVAL_MS;
+const uint EMServer::MAX_PACKET_RATE;
+constexpr double EMServer::MAX_TICK_LOAD;
+constexpr double EMServer::MAX_LOSS;
+const uint EMServer::TX_INTERVAL_STEP_UP;
+const size_t EMServer::MIN_MIX_TASK_SIZE;
+const size_t EMServer::MIN_SEND_SLICE_SIZE;
+
 EMServer::EMServer() :
 	AbstractServer(),
 
+	metrics_port(0),
+	metrics_server(nullptr),
+	latency_report_requested(false),
+	stop_requested(false),
+
 	port(EM::Default::PORT),
 
 	fifo_size(EM::Default::FIFO_SIZE),
@@ -23,18 +44,44 @@ EMServer::EMServer() :
 	buffer_length(EM::Default::BUFFER_LENGTH),
 
 	tx_interval(EM::Default::TX_INTERVAL),
+	max_tx_interval(EM::Default::MAX_TX_INTERVAL),
+
+	max_speakers(EM::Default::MAX_SPEAKERS),
+
+	uplink_port(EM::Default::PORT),
+
+	multicast_port(EM::Default::MULTICAST_PORT),
+
+	packet_filter_level(EM::Default::PACKET_FILTER_LEVEL),
+
+	io_uring(false),
+
+	real_time_priority(EM::Default::REAL_TIME_PRIORITY),
+
+	mixer_threads(EM::Default::MIXER_THREADS),
+
+	replaying(false),
 
 	io_service(),
 
-	udp_socket(io_service, boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), port)),
+	udp_socket(io_service),
 
 	current_nr(0),
 
-	mixer_timer(io_service)
+	mixer_timer(io_service),
+
+	tick_interval(EM::Default::TX_INTERVAL),
+	max_tick_duration(0),
+	retransmit_requests(0),
+	adapt_packets_sent(0),
+
+	housekeeping_time(std::chrono::steady_clock::now())
 {
 	ClientObject *dummy = new ClientObject(0, get_fifo_size(), get_fifo_low_watermark(),
 		get_fifo_high_watermark());
-	clients[0] = dummy;
+	dummy->get_queue().set_residency_histogram(
+		&metrics.get_histogram(Metrics::Latency::QueueResidency));
+	clients.add(dummy);
 }
 
 EMServer::~EMServer()
@@ -102,69 +149,506 @@ uint EMServer::get_tx_interval() const
 	return tx_interval;
 }
 
+void EMServer::set_max_tx_interval(uint max_tx_interval)
+{
+	this->max_tx_interval = max_tx_interval;
+}
+
+uint EMServer::get_max_tx_interval() const
+{
+	return max_tx_interval;
+}
+
+void EMServer::set_max_speakers(uint max_speakers)
+{
+	this->max_speakers = max_speakers;
+}
+
+uint EMServer::get_max_speakers() const
+{
+	return max_speakers;
+}
+
+void EMServer::set_uplink(const std::string &server_name, uint port)
+{
+	uplink_server_name = server_name;
+	uplink_port        = port;
+}
+
+std::string EMServer::get_uplink_server_name() const
+{
+	return uplink_server_name;
+}
+
+uint EMServer::get_uplink_port() const
+{
+	return uplink_port;
+}
+
+void EMServer::set_multicast(const std::string &group, uint port)
+{
+	multicast_group = group;
+	multicast_port  = port;
+}
+
+std::string EMServer::get_multicast_group() const
+{
+	return multicast_group;
+}
+
+uint EMServer::get_multicast_port() const
+{
+	return multicast_port;
+}
+
+void EMServer::set_record_path(const std::string &record_path)
+{
+	this->record_path = record_path;
+}
+
+std::string EMServer::get_record_path() const
+{
+	return record_path;
+}
+
+void EMServer::set_trace_path(const std::string &trace_path)
+{
+	this->trace_path = trace_path;
+}
+
+std::string EMServer::get_trace_path() const
+{
+	return trace_path;
+}
+
+void EMServer::add_source(const std::string &path)
+{
+	source_paths.push_back(path);
+}
+
+const std::vector<std::string> &EMServer::get_source_paths() const
+{
+	return source_paths;
+}
+
+void EMServer::set_packet_filter_level(uint packet_filter_level)
+{
+	this->packet_filter_level = packet_filter_level;
+}
+
+uint EMServer::get_packet_filter_level() const
+{
+	return packet_filter_level;
+}
+
+void EMServer::set_io_uring(bool io_uring)
+{
+	this->io_uring = io_uring;
+}
+
+bool EMServer::get_io_uring() const
+{
+	return io_uring;
+}
+
+void EMServer::set_cpus(const std::vector<uint> &cpus)
+{
+	this->cpus = cpus;
+}
+
+const std::vector<uint> &EMServer::get_cpus() const
+{
+	return cpus;
+}
+
+void EMServer::set_real_time_priority(uint real_time_priority)
+{
+	this->real_time_priority = real_time_priority;
+}
+
+uint EMServer::get_real_time_priority() const
+{
+	return real_time_priority;
+}
+
+void EMServer::set_mixer_threads(uint mixer_threads)
+{
+	this->mixer_threads = mixer_threads;
+}
+
+uint EMServer::get_mixer_threads() const
+{
+	return mixer_threads;
+}
+
+void EMServer::set_metrics_port(uint metrics_port)
+{
+	this->metrics_port = metrics_port;
+}
+
+uint EMServer::get_metrics_port() const
+{
+	return metrics_port;
+}
+
+void EMServer::prepare()
+{
+	client_pool.reset(new ClientPool(get_fifo_size(), get_fifo_low_watermark(),
+		get_fifo_high_watermark()));
+
+	/** A tick never holds more than half the FIFO, the clients couldn't keep up */
+	uint fifo_ms = get_fifo_size() / Mixer::DATA_MS_SIZE;
+	set_tx_interval(std::max(1u, std::min(get_tx_interval(), fifo_ms / 2)));
+	if (get_max_tx_interval() > fifo_ms / 2) {
+		EM_WARN << "The FIFO holds " << fifo_ms << " ms, the tx interval stops at "
+			<< fifo_ms / 2 << " ms.\n";
+		set_max_tx_interval(fifo_ms / 2);
+	}
+	tick_interval = get_tx_interval();
+	metrics.set(Metrics::Gauge::TxInterval, tick_interval);
+	if (get_max_tx_interval() > get_tx_interval())
+		EM_WARN << "Tx interval between " << get_tx_interval() << " and "
+			<< get_max_tx_interval() << " ms.\n";
+
+	if (!get_record_path().empty()) {
+		recorder.reset(new Recorder(get_record_path()));
+		if (!recorder->start())
+			recorder.reset();
+	}
+
+	for (const std::string &path : get_source_paths()) {
+		std::unique_ptr<FileSource> source(new FileSource(path,
+			get_fifo_size(), get_fifo_low_watermark(), get_fifo_high_watermark()));
+		if (source->open())
+			sources.push_back(std::move(source));
+	}
+
+	real_time.reset(new RealTime(get_cpus(), get_real_time_priority()));
+	real_time->lock_memory();
+
+	workers.reset(new WorkerPool(get_mixer_threads(), [this](size_t index) {
+		real_time->setup_thread(RealTime::Role::Worker, index);
+	}));
+	if (get_mixer_threads() > 0)
+		EM_WARN << "Mixing with " << get_mixer_threads() << " helper threads.\n";
+}
+
 void EMServer::start()
 {
+	prepare();
+
+	udp_socket.open(boost::asio::ip::udp::v4());
+	udp_socket.bind(boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), port));
+
+	packet_filter.reset(new PacketFilter(udp_socket.native_handle(),
+		(PacketFilter::Level) std::min(get_packet_filter_level(),
+			(uint) PacketFilter::Level::Sources)));
+	packet_filter->attach();
+
+	if (get_io_uring()) {
+		uring.reset(new UringSocket(io_service, udp_socket.native_handle()));
+		if (uring->start(std::bind(&EMServer::handle_uring_receive, this,
+				std::placeholders::_1, std::placeholders::_2, std::placeholders::_3))) {
+			EM_WARN << "UDP through io_uring.\n";
+		} else {
+			EM_WARN << "Falling back to asio for UDP.\n";
+			uring.reset();
+		}
+	}
+
+	if (!get_multicast_group().empty()) {
+		boost::system::error_code error;
+		boost::asio::ip::address group =
+			boost::asio::ip::address::from_string(get_multicast_group(), error);
+		if (error || !group.is_v4() || !group.is_multicast()) {
+			EM_ERROR << get_multicast_group() << " is not an IPv4 multicast group.\n";
+		} else {
+			udp_socket.set_option(
+				boost::asio::ip::multicast::hops(EM::Default::MULTICAST_HOPS));
+			udp_socket.set_option(boost::asio::ip::multicast::enable_loopback(true));
+			multicast_endpoint = boost::asio::ip::udp::endpoint(group, get_multicast_port());
+			EM_WARN << "Sending the mix to " << multicast_endpoint << ".\n";
+		}
+	}
+
 	tcp_acceptor = new boost::asio::ip::tcp::acceptor(
 		io_service, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port));
-	warn() << "Accepting connections on port " << port << " (IPv4).\n";
+	EM_WARN << "Accepting connections on port " << port << " (IPv4).\n";
 	start_accept();
 
-	std::thread (&EMServer::mixer_routine, this).detach();
-	std::thread (&EMServer::send_info_routine, this).detach();
-	std::thread (&EMServer::udp_receive_routine, this).detach();
-	std::thread (&EMServer::send_routine, this).detach();
+	if (get_metrics_port() != 0) {
+		metrics_server = new MetricsServer(io_service, get_metrics_port(),
+			std::bind(&EMServer::get_metrics_report, this));
+		metrics_server->start();
+	}
 
+	if (!get_trace_path().empty()) {
+		trace.reset(new TraceWriter(get_trace_path()));
+		if (!trace->start())
+			trace.reset();
+	}
+
+	mixer_timer.expires_from_now(boost::posix_time::milliseconds(tick_interval));
+	mixer_timer.async_wait(boost::bind(&EMServer::mixer_routine, this));
+
+	if (!get_uplink_server_name().empty()) {
+		uplink.reset(new TrunkLink(io_service, get_uplink_server_name(), get_uplink_port(),
+			get_fifo_size(), get_fifo_low_watermark(), get_fifo_high_watermark()));
+		uplink->start();
+	}
+
+	std::thread ([this]() {
+		real_time->setup_thread(RealTime::Role::Info);
+		send_info_routine();
+	}).detach();
+	if (uring != nullptr) {
+		std::thread ([this]() {
+			real_time->setup_thread(RealTime::Role::Send);
+			uring_send_routine();
+		}).detach();
+	} else {
+		std::thread (&EMServer::udp_receive_routine, this).detach();
+		std::thread ([this]() {
+			real_time->setup_thread(RealTime::Role::Send);
+			send_routine();
+		}).detach();
+	}
+
+	/** This thread runs the mixer, with the receiving and the connections */
+	real_time->setup_thread(RealTime::Role::Mixer);
 	io_service.run();
 }
 
+void EMServer::replay(const std::string &path, bool max_speed)
+{
+	TraceReader reader(path);
+	if (!reader.open())
+		return;
+
+	replaying = true;
+	prepare();
+	/** No socket to filter, the clients still come and go through it */
+	packet_filter.reset(new PacketFilter(-1, PacketFilter::Level::Off));
+	EM_WARN << "Replaying " << path << (max_speed ? " at full speed" : "") << ".\n";
+
+	/** The mixer ticks on the trace's clock, so a replay mixes the same at any speed */
+	std::chrono::steady_clock::time_point replay_start = std::chrono::steady_clock::now();
+	auto wait_until = [&](uint64_t time_ns) {
+		if (!max_speed)
+			std::this_thread::sleep_until(replay_start + std::chrono::nanoseconds(time_ns));
+	};
+
+	uint64_t tick_ns         = 0;
+	uint64_t housekeeping_ns = 0;
+	uint64_t datagrams       = 0;
+	uint64_t ticks           = 0;
+
+	TraceReader::Datagram datagram;
+	bool pending = reader.read(datagram);
+	while (pending && !stop_requested) {
+		uint64_t next_tick_ns = tick_ns + tick_interval * 1000000ull;
+		if (datagram.time_ns < next_tick_ns) {
+			wait_until(datagram.time_ns);
+			replay_time  = std::chrono::steady_clock::time_point(
+				std::chrono::nanoseconds(datagram.time_ns));
+			udp_endpoint = datagram.endpoint;
+			read_datagram(datagram.data.data(), datagram.data.size());
+			++datagrams;
+			pending = reader.read(datagram);
+		} else {
+			wait_until(next_tick_ns);
+			tick_ns     = next_tick_ns;
+			replay_time = std::chrono::steady_clock::time_point(
+				std::chrono::nanoseconds(tick_ns));
+			mix_tick();
+			++ticks;
+			if (tick_ns - housekeeping_ns >= HOUSEKEEPING_INTERVAL_MS * 1000000ull) {
+				housekeeping_ns = tick_ns;
+				housekeeping();
+			}
+		}
+		discard_sent();
+	}
+
+	double elapsed = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - replay_start).count();
+	EM_WARN << "Replayed " << datagrams << " datagrams and " << ticks << " ticks ("
+		<< tick_ns / 1e9 << " s of trace) in " << elapsed << " s.\n";
+	EM::Logging::flush();
+	std::cerr << metrics.get_latency_report();
+}
+
 void EMServer::quit()
-{}
+{
+	if (recorder != nullptr)
+		recorder->stop();
+	if (trace != nullptr)
+		trace->stop();
+}
+
+void EMServer::request_latency_report()
+{
+	latency_report_requested = true;
+}
+
+void EMServer::request_stop()
+{
+	stop_requested = true;
+}
 
 uint EMServer::get_next_cid()
 {
+	if (!free_cids.empty()) {
+		uint cid = free_cids.front();
+		free_cids.pop_front();
+		return cid;
+	}
+
 	while (true) {
 		uint cid = AbstractServer::get_next_cid();
-		bool used = false;
-
-		for (auto c : clients)
-			if (c.second->get_cid() == cid)
-				used = true;
+		bool used = clients.find(cid) != nullptr;
 		if (!used && cid != 0)
 			return cid;
 	}
-	error() << "get_next_cid: error\n";
+	EM_ERROR << "get_next_cid: error\n";
 	exit(EXIT_SUCCESS);
 }
 
+void EMServer::release_cid(uint cid)
+{
+	free_cids.push_back(cid);
+}
+
+uint64_t EMServer::get_next_token()
+{
+	uint64_t token = 0;
+	while (token == 0)
+		token = ((uint64_t) token_source() << 32) | token_source();
+	return token;
+}
+
 void EMServer::add_client(uint cid)
 {
-	clients[cid] =
-		new ClientObject(cid,
-			get_fifo_size(),
-			get_fifo_low_watermark(),
-			get_fifo_high_watermark());
+	ClientObject *client = client_pool->acquire(cid);
+	client->get_queue().set_residency_histogram(
+		&metrics.get_histogram(Metrics::Latency::QueueResidency));
+	clients.add(client);
+}
+
+std::chrono::steady_clock::time_point EMServer::get_now() const
+{
+	return replaying ? replay_time : std::chrono::steady_clock::now();
+}
+
+ClientObject *EMServer::find_client(uint cid)
+{
+	/** A replay has no TCP side, clients come with their first datagram instead */
+	ClientObject *client = clients.find(cid);
+	if (client == nullptr && replaying && cid != 0) {
+		add_client(cid);
+		client = clients.find(cid);
+		client->set_detached(true);
+	}
+	return client;
 }
 
 void EMServer::on_connection_established(uint cid, Connection *connection)
 {
+	TcpConnection *tcp_connection = dynamic_cast<TcpConnection *>(connection);
 	add_client(cid);
-	clients[cid]->set_connection(
-		dynamic_cast<TcpConnection *>(connection)->shared_from_this());
+	ClientObject *client = clients.find(cid);
+	client->set_connection(tcp_connection->shared_from_this());
+	client->set_token(tcp_connection->get_token());
+
+	boost::system::error_code error;
+	boost::asio::ip::tcp::endpoint endpoint = tcp_connection->get_socket().remote_endpoint(error);
+	if (!error)
+		packet_filter->add_source(cid, endpoint.address());
+}
+
+std::string EMServer::get_greeting() const
+{
+	if (multicast_endpoint.port() == 0)
+		return std::string();
+
+	char greeting[EM::Messages::LENGTH];
+	std::snprintf(greeting, sizeof(greeting), EM::Messages::Multicast.c_str(),
+		multicast_endpoint.address().to_string().c_str(), multicast_endpoint.port());
+	return std::string(greeting);
 }
 
-void EMServer::on_connection_lost(uint cid)
+void EMServer::on_connection_lost(uint cid, Connection *connection)
 {
-	if (clients[cid]->is_connected()) {
-		info() << "Client " << cid << " disconnected.\n";
-		clients[cid]->set_connection(TcpConnection::Pointer(nullptr));
+	ClientObject *client = clients.find(cid);
+	if (client == nullptr || client->get_connection().get() != connection)
+		return;
+
+	/** Likely a network blip, the client comes back with its token if it can */
+	if (client->get_token() != 0 && client->get_udp_endpoint().port() != 0
+			&& !client->is_trunk()) {
+		EM_INFO << "Client " << cid << " lost its connection, kept for resuming.\n";
+		client->set_detached(true);
+		client->set_connection(TcpConnection::Pointer(nullptr));
+		return;
 	}
+
+	EM_INFO << "Client " << cid << " disconnected.\n";
+	retire_client(client);
+}
+
+void EMServer::retire_client(ClientObject *client)
+{
+	client->set_connection(TcpConnection::Pointer(nullptr));
+	packet_filter->remove_source(client->get_cid());
+	clients.remove(client->get_cid());
+}
+
+void EMServer::take_over_connection(
+	ClientObject *client,
+	uint connection_cid,
+	uint64_t connection_token)
+{
+	/** Only a handshake not yet on UDP, and only with the token it was given */
+	ClientObject *handshake = clients.find(connection_cid);
+	if (handshake == nullptr || handshake->get_udp_endpoint().port() != 0
+			|| connection_token == 0 || handshake->get_token() != connection_token)
+		return;
+	TcpConnection::Pointer connection = handshake->get_connection();
+	if (connection == nullptr)
+		return;
+
+	handshake->set_connection(TcpConnection::Pointer(nullptr));
+	retire_client(handshake);
+
+	TcpConnection::Pointer previous = client->get_connection();
+	connection->set_cid(client->get_cid());
+	client->set_connection(connection);
+	client->set_detached(false);
+	if (previous != nullptr)
+		previous->close();
+
+	boost::system::error_code error;
+	boost::asio::ip::tcp::endpoint endpoint = connection->get_socket().remote_endpoint(error);
+	if (!error)
+		packet_filter->add_source(client->get_cid(), endpoint.address());
+}
+
+void EMServer::reclaim_clients()
+{
+	for (ClientObject *client : clients.reclaim()) {
+		free_cids.push_back(client->get_cid());
+		client_pool->release(client);
+	}
+	EM_DEBUG << "Clients: " << client_pool->get_allocated() << " allocated, "
+		<< client_pool->get_free() << " free, " << clients.get_retired_number()
+		<< " retired.\n";
 }
 
 void EMServer::start_accept()
 {
 	TcpConnection::Pointer new_connection =
-		TcpConnection::create(this, tcp_acceptor->get_io_service());
-	log() << "Waiting for connections...\n";
+		TcpConnection::create(this, io_service);
+	EM_LOG << "Waiting for connections...\n";
 	tcp_acceptor->async_accept(
 		new_connection->get_socket(),
 		boost::bind(&EMServer::handle_accept, this, new_connection,
@@ -178,7 +662,7 @@ void EMServer::handle_accept(
 	if (!err)
 		new_connection->start();
 	else
-		warn() << "handle_accept: error\n";
+		EM_WARN << "handle_accept: error\n";
 	start_accept();
 }
 
@@ -189,34 +673,48 @@ void EMServer::send_info_routine()
 	while (true) {
 		timer.expires_from_now(boost::posix_time::milliseconds(SEND_INFO_TIMEOUT_MS));
 		timer.wait();
-		if (get_connected_clients_number() > 0) {
-			debug() << "SEND INFO\n";
-			std::string report("\n");
 
-			for (auto p : clients)
-				if (p.second->is_connected())
-					report += p.second->get_report();
+		if (latency_report_requested.exchange(false))
+			std::cerr << metrics.get_latency_report();
 
-			for (auto p : clients)
-				if (p.second->is_connected())
-					p.second->get_connection()->send_info(report);
-		}
+		ClientRegistry::SnapshotPointer snapshot = clients.get_snapshot();
+		uint connected_clients_number = get_connected_clients_number(*snapshot);
+		metrics.set(Metrics::Gauge::ConnectedClients, connected_clients_number);
+		if (connected_clients_number > 0)
+			io_service.post(boost::bind(&EMServer::send_info, this));
+	}
+}
+
+void EMServer::send_info()
+{
+	EM_DEBUG << "SEND INFO\n";
+	ClientRegistry::SnapshotPointer snapshot = clients.get_snapshot();
+	std::string report("\n");
+
+	for (ClientObject *client : *snapshot)
+		if (client->is_connected())
+			report += client->get_report();
+
+	for (ClientObject *client : *snapshot) {
+		TcpConnection::Pointer connection = client->get_connection();
+		if (client->is_connected() && connection != nullptr)
+			connection->send_info(report);
 	}
 }
 
-uint EMServer::get_connected_clients_number() const
+uint EMServer::get_connected_clients_number(const ClientRegistry::Snapshot &snapshot) const
 {
 	uint cnt = 0;
-	for (auto p : clients)
-		cnt += (int) (p.second->is_connected());
+	for (ClientObject *client : snapshot)
+		cnt += (int) (client->is_connected());
 	return cnt;
 }
 
-uint EMServer::get_active_clients_number() const
+uint EMServer::get_active_clients_number(const ClientRegistry::Snapshot &snapshot) const
 {
 	uint cnt = 0;
-	for (auto p : clients)
-		cnt += (int) (p.second->is_active());
+	for (ClientObject *client : snapshot)
+		cnt += (int) (client->is_active());
 	return cnt;
 }
 
@@ -227,12 +725,12 @@ std::string EMServer::get_address_from_endpoint(boost::asio::ip::udp::endpoint &
 
 uint EMServer::get_cid_from_address(const std::string &address)
 {
-	for (auto p : clients) {
-		if (p.second->get_name().substr(0, address.size()) == address) {
-			if (!p.second->is_connected())
+	for (ClientObject *client : *clients.get_snapshot()) {
+		if (client->get_name() == address) {
+			if (!client->is_connected())
 				return 0;
 			else
-				return p.first;
+				return client->get_cid();
 		}
 	}
 	return 0;
@@ -249,23 +747,71 @@ void EMServer::udp_receive_routine()
 
 void EMServer::handle_receive(const boost::system::error_code &ec, size_t bytes_received)
 {
-	if (ec || bytes_received == 0) {
-		warn() << "server error in udp\n";
+	read_datagram(ec ? nullptr : input_buffer.data(), ec ? 0 : bytes_received);
+	udp_receive_routine();
+}
+
+void EMServer::handle_uring_receive(
+	const char *data,
+	size_t length,
+	const boost::asio::ip::udp::endpoint &sender)
+{
+	udp_endpoint = sender;
+	read_datagram(data, length);
+}
+
+void EMServer::read_datagram(const char *data, size_t bytes_received)
+{
+	std::chrono::steady_clock::time_point receive_start = std::chrono::steady_clock::now();
+
+	if (data == nullptr || bytes_received == 0) {
+		EM_WARN << "server error in udp\n";
+		metrics.add(Metrics::Counter::PacketsDropped);
 	} else {
-		std::string message(input_buffer.begin(), input_buffer.begin() + bytes_received);
+		metrics.add(Metrics::Counter::PacketsReceived);
+		metrics.add(Metrics::Counter::BytesReceived, bytes_received);
+		if (trace != nullptr && !trace->write(receive_start, udp_endpoint, data, bytes_received))
+			metrics.add(Metrics::Counter::TraceDroppedDatagrams);
+
+		std::string message(data, bytes_received);
 		EM::Messages::Type type = EM::Messages::get_type(message);
-		log() << "message from: " << get_address_from_endpoint(udp_endpoint) << "\n";
+		EM_LOG << "message from: " << get_address_from_endpoint(udp_endpoint) << "\n";
 		switch (type) {
 			case EM::Messages::Type::Client: {
-				uint cid = 0;
-				if (EM::Messages::read_client(message, cid)) {
-					log() << "READ " << message << " from "
+				uint cid = 0, rate = 0, channels = 0;
+				bool multicast = false;
+				ClientObject *client = nullptr;
+				if (EM::Messages::read_client(message, cid, rate, channels, multicast)
+					&& (client = find_client(cid)) != nullptr) {
+					EM_LOG << "READ " << message << " from "
 						<< get_address_from_endpoint(udp_endpoint) << ".\n";;
-					clients[cid]->set_udp_endpoint(udp_endpoint);
-					info() << "Added client: " << clients[cid]->get_name() << "\n";
+					client->set_udp_endpoint(udp_endpoint);
+					client->set_format(rate, channels);
+					client->set_multicast(multicast && multicast_endpoint.port() != 0);
+					client->touch(get_now());
+					EM_INFO << "Added client: " << client->get_name()
+						<< " (" << rate << " Hz, " << channels << " channels"
+						<< (client->is_multicast() ? ", multicast" : "") << ")\n";
+				} else {
+					EM_INFO << "READ invalid CLIENT datagram from "
+						<< get_address_from_endpoint(udp_endpoint) << ".\n";
+					metrics.add(Metrics::Counter::PacketsDropped);
+				}
+				break;
+			}
+			case EM::Messages::Type::Trunk: {
+				uint cid = 0;
+				ClientObject *client = nullptr;
+				if (EM::Messages::read_trunk(message, cid)
+					&& (client = find_client(cid)) != nullptr) {
+					client->set_udp_endpoint(udp_endpoint);
+					client->set_trunk(true);
+					client->touch(get_now());
+					EM_INFO << "Added trunk: " << client->get_name() << "\n";
 				} else {
-					info() << "READ invalid CLIENT datagram from "
+					EM_INFO << "READ invalid TRUNK datagram from "
 						<< get_address_from_endpoint(udp_endpoint) << ".\n";
+					metrics.add(Metrics::Counter::PacketsDropped);
 				}
 				break;
 			}
@@ -275,30 +821,36 @@ void EMServer::handle_receive(const boost::system::error_code &ec, size_t bytes_
 					get_cid_from_address(
 						get_address_from_endpoint(udp_endpoint));
 				if (EM::Messages::read_upload(message, nr) && cid != 0) {
+					ClientObject *client = clients.find(cid);
+					client->touch(get_now());
 					size_t index =
 						message.find('\n');
 
 					if (index == message.size()) {
-						info() << "READ empty UPLOAD datagram from "
-							<< clients[cid]->get_name() << "\n";
+						EM_INFO << "READ empty UPLOAD datagram from "
+							<< client->get_name() << "\n";
+						metrics.add(Metrics::Counter::PacketsDropped);
 						break;
 					}
 
-					log() << "READ UPLOAD " << nr << " from "
-						<< clients[cid]->get_name()
+					EM_LOG << "READ UPLOAD " << nr << " from "
+						<< client->get_name()
 						<< " (" << bytes_received - index - 1 << ")\n";
 
-					ClientQueue &queue = clients[cid]->get_queue();
-					if (queue.insert(message.substr(index + 1), nr))
+					ClientQueue &queue = client->get_queue();
+					if (client->insert_upload(message.substr(index + 1), nr))
 						send_ack(udp_endpoint,
 							queue.get_expected_nr(),
-							queue.get_available_space_size());
-					else
-						log() << "READ invalid UPLOAD datagram from "
-							<< clients[cid]->get_name() << "\n";
+							client->get_window());
+					else {
+						EM_LOG << "READ invalid UPLOAD datagram from "
+							<< client->get_name() << "\n";
+						metrics.add(Metrics::Counter::PacketsDropped);
+					}
 				} else {
-					info() << "READ invalid UPLOAD datagram from "
-						<< clients[cid]->get_name() << ".\n";
+					EM_INFO << "READ invalid UPLOAD datagram from "
+						<< get_address_from_endpoint(udp_endpoint) << ".\n";
+					metrics.add(Metrics::Counter::PacketsDropped);
 				}
 				break;
 			}
@@ -308,40 +860,78 @@ void EMServer::handle_receive(const boost::system::error_code &ec, size_t bytes_
 					get_cid_from_address(
 						get_address_from_endpoint(udp_endpoint));
 				if (EM::Messages::read_retransmit(message, nr) && cid != 0) {
-					log() << "READ " << message;
-					if (current_nr - nr <= get_buffer_length()) {
+					EM_LOG << "READ " << message;
+					++retransmit_requests;
+					ClientObject *client = clients.find(cid);
+					client->touch(get_now());
+					/** The history holds full mixes, a trunk must not hear itself */
+					if (current_nr - nr <= get_buffer_length() && !client->is_trunk()) {
 						for (uint i = nr; i < current_nr; ++i) {
-							ClientQueue q = clients[cid]->get_queue();
 							send_data(udp_endpoint, cid, i,
-								q.get_expected_nr(),
-								q.get_available_space_size(),
+								client->get_queue().get_expected_nr(),
+								client->get_window(),
 								messages[i]);
+							metrics.add(Metrics::Counter::Retransmits);
 						}
 					}
 				} else {
-					info() << "READ invalid RETRANSMIT datagram.\n";
+					EM_INFO << "READ invalid RETRANSMIT datagram.\n";
+					metrics.add(Metrics::Counter::PacketsDropped);
+				}
+				break;
+			}
+			case EM::Messages::Type::Resume: {
+				uint cid = 0, connection_cid = 0;
+				uint64_t token = 0, connection_token = 0;
+				ClientObject *client = nullptr;
+				if (EM::Messages::read_resume(message, cid, token, connection_cid, connection_token)
+					&& cid != 0 && (client = clients.find(cid)) != nullptr
+					&& client->get_token() == token) {
+					bool moved = client->get_udp_endpoint() != udp_endpoint;
+					if (connection_cid != 0 && connection_cid != cid)
+						take_over_connection(client, connection_cid, connection_token);
+					client->set_udp_endpoint(udp_endpoint);
+					client->touch(get_now());
+
+					/** The ACK tells the client where its uploads stand, one round trip */
+					send_ack(udp_endpoint, client->get_queue().get_expected_nr(),
+						client->get_window());
+					metrics.add(Metrics::Counter::SessionsResumed);
+					if (moved || connection_cid != 0)
+						EM_INFO << "Client " << cid << " resumed from " << client->get_name() << ".\n";
+					else
+						EM_LOG << "Client " << cid << " resumed.\n";
+				} else {
+					EM_INFO << "READ invalid RESUME datagram from "
+						<< get_address_from_endpoint(udp_endpoint) << ".\n";
+					metrics.add(Metrics::Counter::PacketsDropped);
 				}
 				break;
 			}
 			case EM::Messages::Type::KeepAlive: {
+				uint cid =
+					get_cid_from_address(
+						get_address_from_endpoint(udp_endpoint));
+				if (cid != 0)
+					clients.find(cid)->touch(get_now());
 				break;
 			}
 			default: {
-				info() << "READ Unrecognized datagram: " << message << " ("
+				EM_INFO << "READ Unrecognized datagram: " << message << " ("
 					<< bytes_received << ")\n";
+				metrics.add(Metrics::Counter::PacketsDropped);
 			}
 		}
 	}
-	udp_receive_routine();
+
+	metrics.record(Metrics::Latency::HandleReceive,
+		std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - receive_start).count());
 }
 
 void EMServer::send_ack(boost::asio::ip::udp::endpoint endpoint, uint nr, size_t win)
 {
-	std::string message(EM::Messages::LENGTH, ' ');
-	std::sprintf(&message[0], EM::Messages::Ack.c_str(), nr, win);
-	message = message.substr(0, message.find("\n") + 1);
-
-	add_to_send(message, endpoint);
+	add_to_send(EM::Messages::write_ack(nr, win), endpoint);
 }
 
 void EMServer::send_data(
@@ -350,13 +940,12 @@ void EMServer::send_data(
 	uint nr,
 	uint ack,
 	size_t win,
-	const std::string &data)
+	const std::string &data,
+	std::chrono::steady_clock::time_point mixed_at)
 {
-	std::string message(BUFFER_SIZE, ' ');
-	std::sprintf(&message[0], EM::Messages::Data.c_str(), nr, ack, win);
-	message = message.substr(0, message.find("\n") + 1);
-
-	add_to_send(message + data, endpoint);
+	/** The frame's length goes along, it changes with the tick */
+	add_to_send(EM::Messages::write_data(nr, ack, win, data.size() / Mixer::DATA_MS_SIZE) + data,
+		endpoint, mixed_at);
 }
 
 void EMServer::send_routine()
@@ -367,84 +956,475 @@ void EMServer::send_routine()
 	while (true) {
 		send_mutex.lock();
 		if (!to_send_list.empty()) {
-			std::string msg = to_send_list.front().first;
-			boost::asio::ip::udp::endpoint endpoint = to_send_list.front().second;
+			std::string msg = to_send_list.front().message;
+			boost::asio::ip::udp::endpoint endpoint = to_send_list.front().endpoint;
+			std::chrono::steady_clock::time_point mixed_at = to_send_list.front().mixed_at;
 
-			log() << "SEND " << msg.substr(0, msg.find("\n")) << " to "
+			EM_LOG << "SEND " << msg.substr(0, msg.find("\n")) << " to "
 				<< get_address_from_endpoint(endpoint) << " ("
 				<< msg.size() - msg.find("\n") - 1 << ")\n";
 
-			udp_socket.send_to(boost::asio::buffer(msg), endpoint, flags, ec);
+			size_t bytes_sent =
+				udp_socket.send_to(boost::asio::buffer(msg), endpoint, flags, ec);
 			to_send_list.pop();
+			metrics.set(Metrics::Gauge::SendQueueDepth, to_send_list.size());
 
-			if (ec)
-				warn() << "error in send\n";
+			if (ec) {
+				EM_WARN << "error in send\n";
+				metrics.add(Metrics::Counter::SendErrors);
+			} else {
+				count_sent(bytes_sent, mixed_at);
+			}
 		}
 		send_mutex.unlock();
 	}
 }
 
-void EMServer::add_to_send(const std::string &message, boost::asio::ip::udp::endpoint endpoint)
+void EMServer::uring_send_routine()
+{
+	std::vector<OutgoingDatagram> batch;
+	std::vector<const std::string *> batch_messages;
+	std::vector<boost::asio::ip::udp::endpoint> batch_endpoints;
+	std::vector<int> results;
+
+	while (true) {
+		/** Everything queued goes out in one submission */
+		send_mutex.lock();
+		while (!to_send_list.empty()) {
+			batch.push_back(std::move(to_send_list.front()));
+			to_send_list.pop();
+		}
+		metrics.set(Metrics::Gauge::SendQueueDepth, 0);
+		send_mutex.unlock();
+
+		if (batch.empty())
+			continue;
+
+		for (OutgoingDatagram &datagram : batch) {
+			EM_LOG << "SEND " << datagram.message.substr(0, datagram.message.find("\n"))
+				<< " to " << get_address_from_endpoint(datagram.endpoint) << " ("
+				<< datagram.message.size() - datagram.message.find("\n") - 1 << ")\n";
+			batch_messages.push_back(&datagram.message);
+			batch_endpoints.push_back(datagram.endpoint);
+		}
+
+		uring->send(batch_messages, batch_endpoints, results);
+
+		for (size_t i = 0; i < batch.size(); ++i) {
+			if (results[i] < 0) {
+				EM_WARN << "error in send\n";
+				metrics.add(Metrics::Counter::SendErrors);
+			} else {
+				count_sent(results[i], batch[i].mixed_at);
+			}
+		}
+
+		batch.clear();
+		batch_messages.clear();
+		batch_endpoints.clear();
+	}
+}
+
+void EMServer::discard_sent()
+{
+	/** Nothing goes out in a replay, the clients of the trace aren't listening */
+	send_mutex.lock();
+	while (!to_send_list.empty()) {
+		count_sent(to_send_list.front().message.size(), std::chrono::steady_clock::time_point());
+		to_send_list.pop();
+	}
+	send_mutex.unlock();
+}
+
+void EMServer::count_sent(size_t bytes_sent, std::chrono::steady_clock::time_point mixed_at)
+{
+	metrics.add(Metrics::Counter::PacketsSent);
+	metrics.add(Metrics::Counter::BytesSent, bytes_sent);
+	if (mixed_at != std::chrono::steady_clock::time_point())
+		metrics.record(Metrics::Latency::MixToSend,
+			std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - mixed_at).count());
+}
+
+void EMServer::add_to_send(
+	const std::string &message,
+	boost::asio::ip::udp::endpoint endpoint,
+	std::chrono::steady_clock::time_point mixed_at)
 {
 	send_mutex.lock();
-	to_send_list.push({message, endpoint});
+	to_send_list.push({message, endpoint, mixed_at});
+	metrics.set(Metrics::Gauge::SendQueueDepth, to_send_list.size());
+	send_mutex.unlock();
+}
+
+void EMServer::add_to_send(std::vector<std::vector<OutgoingDatagram> > &batches)
+{
+	send_mutex.lock();
+	for (std::vector<OutgoingDatagram> &batch : batches)
+		for (OutgoingDatagram &datagram : batch)
+			to_send_list.push(std::move(datagram));
+	metrics.set(Metrics::Gauge::SendQueueDepth, to_send_list.size());
 	send_mutex.unlock();
 }
 
 void EMServer::mixer_routine()
 {
-	mixer_timer.expires_from_now(boost::posix_time::milliseconds(get_tx_interval()));
+	if (stop_requested) {
+		io_service.stop();
+		return;
+	}
+
+	/** Ticks are scheduled from the previous deadline, so they don't drift late */
+	boost::posix_time::milliseconds interval(tick_interval);
+	boost::posix_time::ptime deadline = mixer_timer.expires_at() + interval;
+	if (deadline + interval * MAX_MIXER_LAG < boost::asio::deadline_timer::traits_type::now())
+		mixer_timer.expires_from_now(interval);
+	else
+		mixer_timer.expires_at(deadline);
 	mixer_timer.async_wait(boost::bind(&EMServer::mixer_routine, this));
 
-	size_t active_clients_number = get_active_clients_number();
-	Mixer::MixerInput inputs[active_clients_number];
-	uint client_number[active_clients_number];
+	mix_tick();
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - housekeeping_time >= std::chrono::milliseconds(HOUSEKEEPING_INTERVAL_MS)) {
+		housekeeping_time = now;
+		housekeeping();
+	}
+}
+
+void EMServer::mix_tick()
+{
+	std::chrono::steady_clock::time_point tick_start = std::chrono::steady_clock::now();
+
+	ClientRegistry::SnapshotPointer snapshot = clients.get_snapshot();
+
+	size_t data_length = tick_interval * Mixer::DATA_MS_SIZE;
+
+	/** File sources are mixed like clients, but never sent anything */
+	std::vector<ClientObject *> local_clients(snapshot->begin(), snapshot->end());
+	for (std::unique_ptr<FileSource> &source : sources) {
+		source->feed(data_length);
+		local_clients.push_back(&source->get_client());
+	}
+
+	size_t active_clients_number = get_active_clients_number(*snapshot);
+	for (std::unique_ptr<FileSource> &source : sources)
+		active_clients_number += source->get_client().is_active();
+	/** The first input is kept for the remote mix of the uplink */
+	mix_inputs.resize(active_clients_number + 1);
+	Mixer::MixerInput *inputs       = mix_inputs.data();
+	Mixer::MixerInput *local_inputs = inputs + 1;
+	mix_clients.resize(active_clients_number);
+	ClientObject **active_clients = mix_clients.data();
 
-	size_t data_length = get_tx_interval() * Mixer::DATA_MS_SIZE;
-	char data[data_length];
+	mix_output.resize(data_length);
+	char *data = mix_output.data();
 
-	char input_data_array[data_length * active_clients_number];
+	mix_input_data.resize(data_length * (active_clients_number + 1));
+	char *input_data_array = mix_input_data.data();
+	char *local_data_array = input_data_array + data_length;
 
 	/** Collect the data from the queues */
 	size_t active_client = 0;
-	for (auto p : clients) {
-		ClientObject *client = p.second;
-
-		if (client->is_active()) {
-			client_number[active_client] = client->get_cid();
+	size_t fifo_bytes    = 0;
+	for (ClientObject *client : local_clients) {
+		fifo_bytes += client->get_queue().get_size();
+		if (!client->is_active()) {
+			client->set_speaking(false);
+		} else {
+			active_clients[active_client] = client;
 			std::string &&input_data = client->get_queue().get(data_length);
 
-			std::memcpy(input_data_array + data_length * active_client,
+			std::memcpy(local_data_array + data_length * active_client,
 				&input_data[0], input_data.size());
 
-			inputs[active_client].data   =
-				input_data_array + data_length * active_client;
-			inputs[active_client].length = input_data.length();
+			local_inputs[active_client].data   =
+				local_data_array + data_length * active_client;
+			local_inputs[active_client].length = input_data.length();
+
+			if (get_max_speakers() > 0)
+				client->update_energy(Mixer::get_energy(
+					local_inputs[active_client].data, input_data.length()));
 
 			++active_client;
 		}
 	}
 
+	size_t mixed_clients_number = active_clients_number;
+	if (get_max_speakers() > 0)
+		mixed_clients_number = select_speakers(active_clients, local_inputs,
+			active_clients_number, data_length, get_max_speakers());
+
+	/** The uplink gets the local mix only, its remote mix is heard here */
+	ClientObject *remote = nullptr;
+	if (uplink != nullptr) {
+		mix_uplink_output.resize(data_length);
+		size_t uplink_length = data_length;
+		mix(local_inputs, mixed_clients_number, mix_uplink_output.data(), &uplink_length);
+		uplink->upload(mix_uplink_output.data(), uplink_length);
+
+		if (uplink->get_remote().is_active()) {
+			remote = &uplink->get_remote();
+			std::string &&remote_data = remote->get_queue().get(data_length);
+			std::memcpy(input_data_array, &remote_data[0], remote_data.size());
+			inputs[0].data   = input_data_array;
+			inputs[0].length = remote_data.size();
+		}
+	}
+	Mixer::MixerInput *mixed_inputs = remote != nullptr ? inputs : local_inputs;
+	size_t mixed_inputs_number = mixed_clients_number + (remote != nullptr ? 1 : 0);
+
+	/** Trunk clients get the mix without their own contribution */
+	std::vector<std::pair<ClientObject *, std::string> > trunk_mixes;
+	for (size_t i = 0; i < mixed_clients_number; ++i)
+		if (active_clients[i]->is_trunk())
+			trunk_mixes.push_back({active_clients[i],
+				mix_without(mixed_inputs, mixed_inputs_number, &local_inputs[i])});
+
 	/** Mix it */
-	Mixer::mixer(inputs, get_active_clients_number(), data, &data_length,
-		get_tx_interval());
+	mix(mixed_inputs, mixed_inputs_number, data, &data_length);
+	std::chrono::steady_clock::time_point mixed_at = std::chrono::steady_clock::now();
 
-	for (size_t i = 0; i < get_active_clients_number(); ++i)
-		clients[client_number[i]]->get_queue().move(inputs[i].consumed);
+	for (size_t i = 0; i < active_clients_number; ++i)
+		active_clients[i]->get_queue().move(local_inputs[i].consumed);
+	if (remote != nullptr)
+		remote->get_queue().move(inputs[0].consumed);
+
+	if (recorder != nullptr && !recorder->record(data, data_length))
+		metrics.add(Metrics::Counter::RecordingDroppedBytes, data_length);
 
 	/** Add the message to the sent list and erase the old one */
 	messages[current_nr] = std::string(data, data_length);
 	if (messages.find(current_nr - get_buffer_length()) != messages.end())
 		messages.erase(messages.find(current_nr - get_buffer_length()));
 
-	/** Iterate through the clients and send them mixed data */
-	for (auto p : clients) {
-		if (p.second->is_connected())
-			send_data(p.second->get_udp_endpoint(),
-				p.second->get_cid(), current_nr,
-				p.second->get_queue().get_expected_nr(),
-				p.second->get_queue().get_available_space_size(),
-				messages[current_nr]);
-	}
+	send_mix(*snapshot, trunk_mixes, mixed_at);
 	++current_nr;
+
+	metrics.add(Metrics::Counter::MixerTicks);
+	metrics.set(Metrics::Gauge::ActiveClients, active_clients_number);
+	metrics.set(Metrics::Gauge::MixedClients, mixed_clients_number);
+	metrics.set(Metrics::Gauge::FifoBytes, fifo_bytes);
+
+	uint64_t tick_duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - tick_start).count();
+	metrics.set(Metrics::Gauge::MixerTickDurationNs, tick_duration);
+	max_tick_duration = std::max(max_tick_duration, tick_duration);
+	metrics.record(Metrics::Latency::MixerTick, tick_duration);
+}
+
+void EMServer::mix(
+	Mixer::MixerInput *inputs,
+	size_t inputs_number,
+	char *output_buffer,
+	size_t *output_size)
+{
+	*output_size = tick_interval * Mixer::DATA_MS_SIZE;
+	Mixer::consume(inputs, inputs_number, *output_size);
+
+	/** Ranges on cache line bounds, so the tasks never write the same line */
+	static const size_t LINE_SAMPLES = 64 / sizeof(EM::data_t);
+	size_t samples = *output_size / sizeof(EM::data_t);
+	size_t tasks = std::min(workers->get_size(), inputs_number * samples / MIN_MIX_TASK_SIZE);
+	tasks = std::max(tasks, (size_t) 1);
+
+	workers->run(tasks, [=](size_t task) {
+		size_t first = samples * task / tasks / LINE_SAMPLES * LINE_SAMPLES;
+		size_t last  = task + 1 == tasks ?
+			samples : samples * (task + 1) / tasks / LINE_SAMPLES * LINE_SAMPLES;
+		Mixer::mix_range(inputs, inputs_number, output_buffer, first, last);
+	});
+}
+
+void EMServer::send_mix(
+	const ClientRegistry::Snapshot &receivers,
+	const std::vector<std::pair<ClientObject *, std::string> > &trunk_mixes,
+	std::chrono::steady_clock::time_point mixed_at)
+{
+	const std::string &data = messages[current_nr];
+	uint nr = current_nr;
+
+	size_t slices = std::min(workers->get_size(), receivers.size() / MIN_SEND_SLICE_SIZE);
+	slices = std::max(slices, (size_t) 1);
+	std::vector<std::vector<OutgoingDatagram> > batches(slices);
+	std::vector<size_t> multicast_clients(slices, 0);
+
+	/** Every slice builds its own datagrams, they are queued together below */
+	workers->run(slices, [&](size_t slice) {
+		size_t first = receivers.size() * slice / slices;
+		size_t last  = receivers.size() * (slice + 1) / slices;
+		std::vector<OutgoingDatagram> &batch = batches[slice];
+		batch.reserve(last - first);
+
+		for (size_t i = first; i < last; ++i) {
+			ClientObject *client = receivers[i];
+			if (!client->is_connected())
+				continue;
+
+			/** The mix itself goes to the group once, below */
+			if (client->is_multicast()) {
+				batch.push_back({EM::Messages::write_ack(
+					client->get_queue().get_expected_nr(), client->get_window()),
+					client->get_udp_endpoint(), std::chrono::steady_clock::time_point()});
+				++multicast_clients[slice];
+				continue;
+			}
+
+			const std::string *payload = &data;
+			for (const std::pair<ClientObject *, std::string> &trunk_mix : trunk_mixes)
+				if (trunk_mix.first == client)
+					payload = &trunk_mix.second;
+
+			/** The frame's length goes along, it changes with the tick */
+			batch.push_back({EM::Messages::write_data(nr,
+				client->get_queue().get_expected_nr(), client->get_window(),
+				payload->size() / Mixer::DATA_MS_SIZE) + *payload,
+				client->get_udp_endpoint(), mixed_at});
+		}
+	});
+
+	add_to_send(batches);
+
+	size_t multicast_clients_number = 0;
+	for (size_t count : multicast_clients)
+		multicast_clients_number += count;
+	if (multicast_clients_number > 0)
+		add_to_send(EM::Messages::write_data(nr, 0, 0, tick_interval) + data,
+			multicast_endpoint, mixed_at);
+}
+
+std::string EMServer::mix_without(
+	const Mixer::MixerInput *inputs,
+	size_t inputs_number,
+	const Mixer::MixerInput *excluded)
+{
+	std::vector<Mixer::MixerInput> others;
+	others.reserve(inputs_number);
+	for (size_t i = 0; i < inputs_number; ++i)
+		if (&inputs[i] != excluded)
+			others.push_back(inputs[i]);
+
+	size_t length = tick_interval * Mixer::DATA_MS_SIZE;
+	std::string data(length, '\0');
+	mix(others.data(), others.size(), &data[0], &length);
+	data.resize(length);
+	return data;
+}
+
+size_t EMServer::select_speakers(
+	ClientObject **active_clients,
+	Mixer::MixerInput *inputs,
+	size_t active_clients_number,
+	size_t data_length,
+	size_t max_speakers)
+{
+	/** Current speakers count louder, so close contenders don't flap */
+	std::vector<std::pair<uint64_t, size_t> > scores;
+	scores.reserve(active_clients_number);
+	for (size_t i = 0; i < active_clients_number; ++i) {
+		if (active_clients[i]->is_trunk())
+			continue;
+		uint64_t energy = active_clients[i]->get_energy();
+		if (active_clients[i]->is_speaking())
+			energy *= SPEAKER_HYSTERESIS;
+		scores.push_back({energy, i});
+	}
+	size_t k = std::min(max_speakers, scores.size());
+	std::nth_element(scores.begin(), scores.begin() + k, scores.end(),
+		std::greater<std::pair<uint64_t, size_t> >());
+
+	for (size_t i = 0; i < active_clients_number; ++i)
+		active_clients[i]->set_speaking(active_clients[i]->is_trunk());
+	for (size_t i = 0; i < k; ++i)
+		active_clients[scores[i].second]->set_speaking(true);
+
+	/** Speakers go first for the mixer, the rest is drained as if mixed */
+	size_t speakers = 0;
+	for (size_t i = 0; i < active_clients_number; ++i) {
+		if (active_clients[i]->is_speaking()) {
+			std::swap(active_clients[i], active_clients[speakers]);
+			std::swap(inputs[i], inputs[speakers]);
+			++speakers;
+		}
+	}
+	for (size_t i = speakers; i < active_clients_number; ++i)
+		inputs[i].consumed = std::min(inputs[i].length, data_length);
+
+	return speakers;
+}
+
+void EMServer::housekeeping()
+{
+	compensate_drift();
+	adapt_tx_interval();
+	if (uplink != nullptr)
+		uplink->get_remote().compensate_drift();
+
+	/** Clients gone silent, the TCP side alone may never notice */
+	std::chrono::steady_clock::time_point now = get_now();
+	for (ClientObject *client : *clients.get_snapshot()) {
+		std::chrono::milliseconds timeout(
+			client->is_detached() && !replaying ? RESUME_TIMEOUT_MS : CLIENT_TIMEOUT_MS);
+		if (client->get_cid() != 0 && now - client->get_last_activity() > timeout) {
+			EM_INFO << "Client " << client->get_cid() << " timed out.\n";
+			TcpConnection::Pointer connection = client->get_connection();
+			if (connection != nullptr)
+				connection->close();
+			retire_client(client);
+		}
+	}
+
+	reclaim_clients();
+}
+
+void EMServer::compensate_drift()
+{
+	for (ClientObject *client : *clients.get_snapshot())
+		if (client->is_connected()) {
+			client->compensate_drift();
+			EM_DEBUG << "Drift of " << client->get_name() << ": FIFO "
+				<< client->get_queue().get_size() << ", ratio "
+				<< client->get_ratio_adjustment() << "\n";
+		}
+}
+
+void EMServer::adapt_tx_interval()
+{
+	uint64_t packets_sent = metrics.get(Metrics::Counter::PacketsSent);
+	double loss = packets_sent > adapt_packets_sent
+		? (double) retransmit_requests / (packets_sent - adapt_packets_sent) : 0;
+	/** The replaying host isn't the recording one, its load would make replays differ */
+	double load = replaying ? 0 : max_tick_duration / (tick_interval * 1e6);
+	adapt_packets_sent  = packets_sent;
+	retransmit_requests = 0;
+	max_tick_duration   = 0;
+
+	uint max_interval = std::max(get_max_tx_interval(), get_tx_interval());
+	if (max_interval == get_tx_interval())
+		return;
+
+	/** Every client gets a datagram a tick */
+	uint clients_number = get_connected_clients_number(*clients.get_snapshot());
+	uint needed = (clients_number * 1000 + MAX_PACKET_RATE - 1) / MAX_PACKET_RATE;
+
+	/** Up fast when in trouble, down a ms at a time once well clear of it */
+	uint interval = tick_interval;
+	if (load > MAX_TICK_LOAD || loss > MAX_LOSS)
+		interval += TX_INTERVAL_STEP_UP;
+	else if (load < MAX_TICK_LOAD / 2 && loss < MAX_LOSS / 2 && interval > 0)
+		--interval;
+	interval = std::max(interval, needed);
+	interval = std::max(get_tx_interval(), std::min(max_interval, interval));
+
+	if (interval != tick_interval) {
+		EM_INFO << "Tx interval " << tick_interval << " -> " << interval << " ms ("
+			<< clients_number << " clients, load " << load << ", loss " << loss << ").\n";
+		tick_interval = interval;
+		metrics.set(Metrics::Gauge::TxInterval, tick_interval);
+	}
+}
+
+std::string EMServer::get_metrics_report() const
+{
+	return metrics.to_prometheus();
 }
@@ -1,16 +1,35 @@
 #ifndef EMSERVER_H
 #define EMSERVER_H
 
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <queue>
+#include <random>
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
 #include <mutex>
 #include <sys/types.h>
 #include <unordered_map>
+#include <vector>
 
 #include "Server/ClientObject.h"
+#include "Server/ClientPool.h"
+#include "Server/ClientRegistry.h"
+#include "Server/FileSource.h"
+#include "Server/Metrics.h"
+#include "Server/MetricsServer.h"
 #include "Server/Mixer.h"
+#include "Server/PacketFilter.h"
+#include "Server/RealTime.h"
+#include "Server/Recorder.h"
 #include "Server/TcpConnection.h"
+#include "Server/TraceReader.h"
+#include "Server/TraceWriter.h"
+#include "Server/TrunkLink.h"
+#include "Server/UringSocket.h"
+#include "Server/WorkerPool.h"
 #include "System/AbstractServer.h"
 
 class EMServer : public AbstractServer
@@ -32,16 +51,101 @@ public:
 	void set_buffer_length(uint buffer_length);
 	uint get_buffer_length() const;
 
+	/** The shortest tick, and the only one unless a longer one is allowed */
 	void set_tx_interval(uint tx_interval);
 	uint get_tx_interval() const;
 
+	/** Lets the tick grow up to this with the load, 0 keeps it fixed */
+	void set_max_tx_interval(uint max_tx_interval);
+	uint get_max_tx_interval() const;
+
+	void set_max_speakers(uint max_speakers);
+	uint get_max_speakers() const;
+
+	/** Joins another server as a trunk, the meeting then spans both */
+	void set_uplink(const std::string &server_name, uint port);
+	std::string get_uplink_server_name() const;
+	uint get_uplink_port() const;
+
+	/** Sends the mix once to a group, for the clients that join it */
+	void set_multicast(const std::string &group, uint port);
+	std::string get_multicast_group() const;
+	uint get_multicast_port() const;
+
+	void set_record_path(const std::string &record_path);
+	std::string get_record_path() const;
+
+	/** Traces the received datagrams, for the replay tool */
+	void set_trace_path(const std::string &trace_path);
+	std::string get_trace_path() const;
+
+	/** Plays a file in the meeting as a virtual participant, once per call */
+	void add_source(const std::string &path);
+	const std::vector<std::string> &get_source_paths() const;
+
+	/** 0 off, 1 known headers only, 2 also from TCP clients' addresses only */
+	void set_packet_filter_level(uint packet_filter_level);
+	uint get_packet_filter_level() const;
+
+	/** UDP through io_uring, asio stays in use where the kernel can't */
+	void set_io_uring(bool io_uring);
+	bool get_io_uring() const;
+
+	/** Cores for the mixer, send, info and worker threads, in turn; empty leaves them free */
+	void set_cpus(const std::vector<uint> &cpus);
+	const std::vector<uint> &get_cpus() const;
+
+	/** SCHED_FIFO priority of the mixer, 0 keeps the default policy */
+	void set_real_time_priority(uint real_time_priority);
+	uint get_real_time_priority() const;
+
+	/**
+	 * Threads that share a tick's mixing and sending with the mixer, 0 for none.
+	 * They only take work from about 150 clients at 5 ms, see MIN_MIX_TASK_SIZE,
+	 * and below that the wake-ups make a tick slower than the mixer alone
+	 */
+	void set_mixer_threads(uint mixer_threads);
+	uint get_mixer_threads() const;
+
+	void set_metrics_port(uint metrics_port);
+	uint get_metrics_port() const;
+
+	/** Returns once stopped by request_stop() */
 	void start();
+	/** Finishes the recording and the trace, after start() or replay() returned */
 	void quit();
 
+	/**
+	 * Feeds a trace through the receiving and the mixer instead of the network,
+	 * in real time or as fast as it goes; nothing is sent
+	 */
+	void replay(const std::string &path, bool max_speed);
+
+	/** Both only raise a flag the mixer looks at, safe from a signal handler */
+	void request_latency_report();
+	void request_stop();
+
+	/**
+	 * Puts the trunks and the max_speakers loudest other clients first and
+	 * returns their number. Trunks are always mixed, a whole room may be behind
+	 * a quiet one
+	 */
+	static size_t select_speakers(
+		ClientObject **active_clients,
+		Mixer::MixerInput *inputs,
+		size_t active_clients_number,
+		size_t data_length,
+		size_t max_speakers);
+
+	static const uint SPEAKER_HYSTERESIS = 2;
+
 	virtual uint get_next_cid();
+	virtual void release_cid(uint cid);
+	virtual uint64_t get_next_token();
 	virtual void add_client(uint cid);
 	virtual void on_connection_established(uint cid, Connection *connection);
-	virtual void on_connection_lost(uint cid);
+	virtual void on_connection_lost(uint cid, Connection *connection);
+	virtual std::string get_greeting() const;
 
 private:
 	/** TCP */
@@ -50,8 +154,10 @@ private:
 	void handle_accept(TcpConnection::Pointer new_connection,
 	                   const boost::system::error_code &error);
 	void send_info_routine();
-	uint get_connected_clients_number() const;
-	uint get_active_clients_number() const;
+	/** On the io_service thread, where the queues are filled and drained */
+	void send_info();
+	uint get_connected_clients_number(const ClientRegistry::Snapshot &snapshot) const;
+	uint get_active_clients_number(const ClientRegistry::Snapshot &snapshot) const;
 
 	/** UDP */
 
@@ -60,21 +166,68 @@ private:
 
 	void udp_receive_routine();
 	void handle_receive(const boost::system::error_code &ec, size_t bytes_received);
+	void handle_uring_receive(
+		const char *data,
+		size_t length,
+		const boost::asio::ip::udp::endpoint &sender);
+	/** A datagram from udp_endpoint, nullptr for a failed receive */
+	void read_datagram(const char *data, size_t bytes_received);
 	void send_ack(boost::asio::ip::udp::endpoint endpoint, uint nr, size_t win);
 	void send_data(
 		boost::asio::ip::udp::endpoint endpoint,
 		uint cid,
 		uint nr,
 		uint ack,
-		size_t win, const std::string &data);
+		size_t win, const std::string &data,
+		std::chrono::steady_clock::time_point mixed_at =
+			std::chrono::steady_clock::time_point());
+
+	struct OutgoingDatagram {
+		std::string message;
+		boost::asio::ip::udp::endpoint endpoint;
+		/** When the carried mix was produced, epoch for anything else */
+		std::chrono::steady_clock::time_point mixed_at;
+	};
 
 	void send_routine();
-	void add_to_send(const std::string &message, boost::asio::ip::udp::endpoint endpoint);
+	void uring_send_routine();
+	void count_sent(size_t bytes_sent, std::chrono::steady_clock::time_point mixed_at);
+	void add_to_send(
+		const std::string &message,
+		boost::asio::ip::udp::endpoint endpoint,
+		std::chrono::steady_clock::time_point mixed_at =
+			std::chrono::steady_clock::time_point());
+	/** Several batches under one lock, as the workers built them */
+	void add_to_send(std::vector<std::vector<OutgoingDatagram> > &batches);
 
 	std::mutex send_mutex;
-	std::queue<std::pair<std::string, boost::asio::ip::udp::endpoint> > to_send_list;
+	std::queue<OutgoingDatagram> to_send_list;
+
+	/** Sent datagrams are only counted while replaying */
+	void discard_sent();
+
+	/** The mixer's setup, shared by start() and replay() */
+	void prepare();
 
 	void mixer_routine();
+	void mix_tick();
+
+	/** The tick's buffers, on the heap and reused, a large room would overflow the stack */
+	std::vector<Mixer::MixerInput> mix_inputs;
+	std::vector<ClientObject *> mix_clients;
+	std::vector<char> mix_input_data;
+	std::vector<char> mix_output;
+	std::vector<char> mix_uplink_output;
+
+	/** Metrics */
+
+	std::string get_metrics_report() const;
+
+	Metrics metrics;
+	uint metrics_port;
+	MetricsServer *metrics_server;
+	std::atomic<bool> latency_report_requested;
+	std::atomic<bool> stop_requested;
 
 	uint port;
 
@@ -85,8 +238,69 @@ private:
 	uint buffer_length;
 
 	uint tx_interval;
+	uint max_tx_interval;
+
+	uint max_speakers;
 
-	std::unordered_map<uint, ClientObject *> clients;
+	std::string uplink_server_name;
+	uint uplink_port;
+	std::unique_ptr<TrunkLink> uplink;
+
+	std::string multicast_group;
+	uint multicast_port;
+	/** Unspecified unless multicast is on */
+	boost::asio::ip::udp::endpoint multicast_endpoint;
+
+	uint packet_filter_level;
+	std::unique_ptr<PacketFilter> packet_filter;
+
+	bool io_uring;
+	std::unique_ptr<UringSocket> uring;
+
+	std::vector<uint> cpus;
+	uint real_time_priority;
+	std::unique_ptr<RealTime> real_time;
+
+	uint mixer_threads;
+	std::unique_ptr<WorkerPool> workers;
+
+	std::string record_path;
+	std::unique_ptr<Recorder> recorder;
+
+	std::string trace_path;
+	std::unique_ptr<TraceWriter> trace;
+	bool replaying;
+	/** The trace's time while replaying, from the clock's epoch */
+	std::chrono::steady_clock::time_point replay_time;
+
+	/** The time client activity is judged by, the trace's one while replaying */
+	std::chrono::steady_clock::time_point get_now() const;
+
+	std::vector<std::string> source_paths;
+	std::vector<std::unique_ptr<FileSource> > sources;
+
+	ClientRegistry clients;
+
+	/** Clients */
+
+	/** Also creates the client while replaying */
+	ClientObject *find_client(uint cid);
+	void retire_client(ClientObject *client);
+	/** Moves the TCP connection of a fresh handshake onto a resumed client */
+	void take_over_connection(
+		ClientObject *client,
+		uint connection_cid,
+		uint64_t connection_token);
+	void reclaim_clients();
+
+	std::unique_ptr<ClientPool> client_pool;
+	/** Cids of reclaimed clients, reused oldest first */
+	std::deque<uint> free_cids;
+	std::random_device token_source;
+
+	static const uint CLIENT_TIMEOUT_MS = 10000;
+	/** How long a client without its TCP connection may stay quiet */
+	static const uint RESUME_TIMEOUT_MS = 3000;
 
 	boost::asio::io_service io_service;
 	boost::asio::ip::tcp::acceptor *tcp_acceptor;
@@ -101,8 +315,61 @@ private:
 	uint current_nr;
 	std::unordered_map<uint, std::string> messages;
 
+	/** Ticks behind schedule after which the mixer stops catching up */
+	static const uint MAX_MIXER_LAG = 10;
 	boost::asio::deadline_timer mixer_timer;
 	boost::array<char, BUFFER_SIZE> input_buffer;
+
+	/** Mixer::mixer, in sample ranges across the workers when the room is large */
+	void mix(
+		Mixer::MixerInput *inputs,
+		size_t inputs_number,
+		char *output_buffer,
+		size_t *output_size);
+
+	/** Sends the tick's mix to every client, in slices across the workers */
+	void send_mix(
+		const ClientRegistry::Snapshot &receivers,
+		const std::vector<std::pair<ClientObject *, std::string> > &trunk_mixes,
+		std::chrono::steady_clock::time_point mixed_at);
+
+	/**
+	 * Samples summed by one task, and clients served by one slice, at least;
+	 * two tasks take 149 inputs of a 5 ms tick (440 samples each)
+	 */
+	static const size_t MIN_MIX_TASK_SIZE   = 32768;
+	static const size_t MIN_SEND_SLICE_SIZE = 64;
+
+	/** Mixes the inputs but one, for trunk clients */
+	std::string mix_without(
+		const Mixer::MixerInput *inputs,
+		size_t inputs_number,
+		const Mixer::MixerInput *excluded);
+
+	/** Drift compensation and reclamation, once in a while from the mixer */
+
+	void housekeeping();
+	void compensate_drift();
+
+	/** Adaptive tick, longer when the room is big, the mixer busy or datagrams lost */
+
+	void adapt_tx_interval();
+
+	/** DATA datagrams a second the room aims to stay under */
+	static const uint MAX_PACKET_RATE = 20000;
+	/** Share of the tick the mixer may take, and of the DATA asked for again */
+	static constexpr double MAX_TICK_LOAD = 0.5;
+	static constexpr double MAX_LOSS      = 0.02;
+	static const uint TX_INTERVAL_STEP_UP = 2;
+
+	/** The current tick, between tx_interval and max_tx_interval */
+	uint tick_interval;
+	uint64_t max_tick_duration;
+	uint64_t retransmit_requests;
+	uint64_t adapt_packets_sent;
+
+	static const uint HOUSEKEEPING_INTERVAL_MS = 1000;
+	std::chrono::steady_clock::time_point housekeeping_time;
 };
 
 #endif // EMSERVER_H
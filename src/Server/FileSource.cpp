@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Server/FileSource.h"
+#include "System/Logging.h"
+#include "System/Utils.h"
+
+/**
+ * \class FileSource
+ */
+
+namespace {
+	uint32_t get_le(const char *source, size_t bytes)
+	{
+		uint32_t value = 0;
+		for (size_t i = 0; i < bytes; ++i)
+			value |= (uint32_t) (unsigned char) source[i] << (8 * i);
+		return value;
+	}
+}
+
+FileSource::FileSource(
+	const std::string &path,
+	size_t fifo_size,
+	size_t fifo_low_watermark,
+	size_t fifo_high_watermark) :
+
+	path(path),
+
+	file(nullptr),
+	file_size(0),
+
+	data_begin(0),
+	data_end(0),
+	position(0),
+
+	rate(EM::Default::SAMPLE_RATE),
+	channels(EM::Default::CHANNELS),
+
+	fifo_high_watermark(fifo_high_watermark),
+	client(0, fifo_size, fifo_low_watermark, fifo_high_watermark)
+{}
+
+FileSource::~FileSource()
+{
+	if (file != nullptr)
+		::munmap((void *) file, file_size);
+}
+
+bool FileSource::open()
+{
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		EM_ERROR << "Unable to open " << path << ".\n";
+		return false;
+	}
+
+	struct stat status;
+	if (::fstat(fd, &status) != 0 || status.st_size == 0) {
+		EM_ERROR << "Unable to play the empty " << path << ".\n";
+		::close(fd);
+		return false;
+	}
+	file_size = status.st_size;
+
+	void *mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED) {
+		EM_ERROR << "Unable to map " << path << ".\n";
+		return false;
+	}
+	file = (const char *) mapping;
+	::madvise(mapping, file_size, MADV_SEQUENTIAL);
+
+	data_end = file_size;
+	if (file_size >= 12 && std::memcmp(file, "RIFF", 4) == 0
+			&& std::memcmp(file + 8, "WAVE", 4) == 0 && !read_wav_header()) {
+		EM_ERROR << "Unable to play " << path << ", only 16-bit PCM is supported.\n";
+		return false;
+	}
+
+	size_t frame_size = channels * sizeof(EM::data_t);
+	data_end -= (data_end - data_begin) % frame_size;
+	if (data_end == data_begin) {
+		EM_ERROR << "No samples in " << path << ".\n";
+		return false;
+	}
+	position = data_begin;
+
+	client.set_format(rate, channels);
+	EM_WARN << "Playing " << path << " (" << rate << " Hz, " << channels << " channels).\n";
+	return true;
+}
+
+void FileSource::feed(size_t tick_length)
+{
+	static const size_t FRAME_SIZE = EM::Default::CHANNELS * sizeof(EM::data_t);
+
+	ClientQueue &queue = client.get_queue();
+	size_t target = std::min(std::max(fifo_high_watermark, tick_length), queue.get_max_size());
+
+	/** One tick of the file's own data converts to about one tick of the room's */
+	size_t chunk_length = (size_t) ((uint64_t) tick_length * rate * channels
+		/ (EM::Default::SAMPLE_RATE * EM::Default::CHANNELS));
+	chunk_length = std::max(chunk_length - chunk_length % (channels * sizeof(EM::data_t)),
+		channels * sizeof(EM::data_t));
+
+	while (queue.get_size() < target) {
+		if (pending.empty())
+			pending = client.convert(read_chunk(chunk_length));
+
+		size_t length = std::min(pending.size(), target - queue.get_size());
+		length -= length % FRAME_SIZE;
+		if (length == 0)
+			break;
+
+		queue.insert(pending.substr(0, length), 0);
+		pending.erase(0, length);
+	}
+}
+
+ClientObject &FileSource::get_client()
+{
+	return client;
+}
+
+std::string FileSource::get_path() const
+{
+	return path;
+}
+
+bool FileSource::read_wav_header()
+{
+	bool format_found = false;
+	size_t offset = 12;
+
+	while (offset + 8 <= file_size) {
+		const char *chunk = file + offset;
+		size_t chunk_size = get_le(chunk + 4, 4);
+		offset += 8;
+
+		if (std::memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16 && offset + 16 <= file_size) {
+			uint format = get_le(chunk + 8, 2);
+			uint bits   = get_le(chunk + 22, 2);
+			channels    = get_le(chunk + 10, 2);
+			rate        = get_le(chunk + 12, 4);
+			/** 0xfffe is WAVE_FORMAT_EXTENSIBLE, taken for plain PCM */
+			if ((format != 1 && format != 0xfffe) || bits != 16 || channels == 0 || rate == 0)
+				return false;
+			format_found = true;
+		} else if (std::memcmp(chunk, "data", 4) == 0) {
+			data_begin = offset;
+			/** Streamed files leave the size at zero or too big */
+			data_end = chunk_size == 0 ? file_size : std::min(file_size, offset + chunk_size);
+			return format_found;
+		}
+
+		offset += chunk_size + chunk_size % 2;
+	}
+
+	return false;
+}
+
+std::string FileSource::read_chunk(size_t length)
+{
+	std::string chunk;
+	chunk.reserve(length);
+
+	while (chunk.size() < length) {
+		size_t part = std::min(length - chunk.size(), data_end - position);
+		chunk.append(file + position, part);
+		position += part;
+		if (position == data_end)
+			position = data_begin;
+	}
+
+	return chunk;
+}
@@ -0,0 +1,59 @@
+#ifndef FILESOURCE_H
+#define FILESOURCE_H
+
+#include <string>
+
+#include "Server/ClientObject.h"
+
+/**
+ * A virtual participant playing a file in a loop, for hold music, announcements
+ * or a mixer baseline without any network in the way.
+ *
+ * The file is memory-mapped and read in place. It holds 16-bit PCM, either raw in
+ * the room format or as a WAV of any rate and channel count, converted like the
+ * upload of a client. The mixer feeds it once per tick, topping the queue of its
+ * ClientObject up to the high watermark, so it plays exactly at the mixer's rate.
+ */
+class FileSource
+{
+public:
+	FileSource(
+		const std::string &path,
+		size_t fifo_size,
+		size_t fifo_low_watermark,
+		size_t fifo_high_watermark);
+	~FileSource();
+
+	/** False if the file could not be mapped or holds nothing playable */
+	bool open();
+
+	/** Queues enough of the file to last until the next tick */
+	void feed(size_t tick_length);
+
+	ClientObject &get_client();
+	std::string get_path() const;
+
+private:
+	bool read_wav_header();
+	std::string read_chunk(size_t length);
+
+	std::string path;
+
+	const char *file;
+	size_t file_size;
+
+	/** The PCM part of the file, played from position and looped */
+	size_t data_begin;
+	size_t data_end;
+	size_t position;
+
+	uint rate;
+	uint channels;
+
+	size_t fifo_high_watermark;
+	ClientObject client;
+	/** Converted data the queue had no room for yet */
+	std::string pending;
+};
+
+#endif // FILESOURCE_H
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Server/IoUring.h"
+
+/**
+ * \class IoUring
+ */
+
+namespace {
+	template <typename T>
+	T *at(void *base, uint offset)
+	{
+		return (T *) ((char *) base + offset);
+	}
+}
+
+IoUring::IoUring() :
+	fd(-1),
+
+	sq_ring(MAP_FAILED),
+	sq_ring_size(0),
+	cq_ring(MAP_FAILED),
+	cq_ring_size(0),
+	sqes((io_uring_sqe *) MAP_FAILED),
+	sqes_size(0),
+
+	sq_head(nullptr),
+	sq_tail(nullptr),
+	sq_array(nullptr),
+	sq_mask(0),
+	sq_entries(0),
+	sqe_tail(0),
+
+	cq_head(nullptr),
+	cq_tail(nullptr),
+	cq_mask(0),
+	cqes(nullptr)
+{}
+
+IoUring::~IoUring()
+{
+	if (sqes != MAP_FAILED)
+		::munmap(sqes, sqes_size);
+	if (cq_ring != MAP_FAILED && cq_ring != sq_ring)
+		::munmap(cq_ring, cq_ring_size);
+	if (sq_ring != MAP_FAILED)
+		::munmap(sq_ring, sq_ring_size);
+	if (fd >= 0)
+		::close(fd);
+}
+
+bool IoUring::init(uint entries)
+{
+	io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+
+	fd = (int) ::syscall(__NR_io_uring_setup, entries, &params);
+	if (fd < 0)
+		return false;
+
+	sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint);
+	cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (single_mmap)
+		sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+	sq_ring = ::mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq_ring == MAP_FAILED)
+		return false;
+	cq_ring = single_mmap ? sq_ring : ::mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	if (cq_ring == MAP_FAILED)
+		return false;
+
+	sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+	sqes = (io_uring_sqe *) ::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+		return false;
+
+	sq_head    = at<uint>(sq_ring, params.sq_off.head);
+	sq_tail    = at<uint>(sq_ring, params.sq_off.tail);
+	sq_array   = at<uint>(sq_ring, params.sq_off.array);
+	sq_mask    = *at<uint>(sq_ring, params.sq_off.ring_mask);
+	sq_entries = params.sq_entries;
+	sqe_tail   = *sq_tail;
+
+	cq_head = at<uint>(cq_ring, params.cq_off.head);
+	cq_tail = at<uint>(cq_ring, params.cq_off.tail);
+	cq_mask = *at<uint>(cq_ring, params.cq_off.ring_mask);
+	cqes    = at<io_uring_cqe>(cq_ring, params.cq_off.cqes);
+
+	return true;
+}
+
+io_uring_sqe *IoUring::get_sqe()
+{
+	uint head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+	if (sqe_tail - head >= sq_entries)
+		return nullptr;
+
+	io_uring_sqe *sqe = &sqes[sqe_tail & sq_mask];
+	sq_array[sqe_tail & sq_mask] = sqe_tail & sq_mask;
+	++sqe_tail;
+
+	std::memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+int IoUring::submit(uint wait_nr)
+{
+	/** Left over from a short submission too, not only the new ones */
+	uint to_submit = sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+	__atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+
+	uint flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+	int result;
+	do {
+		result = (int) ::syscall(__NR_io_uring_enter, fd, to_submit, wait_nr, flags,
+			nullptr, 0);
+	} while (result < 0 && errno == EINTR);
+
+	return result < 0 ? -errno : result;
+}
+
+uint IoUring::drop_unsubmitted()
+{
+	/** Without a polling thread the kernel reads the ring only in submit() */
+	uint head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+	uint dropped = sqe_tail - head;
+	sqe_tail = head;
+	__atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+	return dropped;
+}
+
+io_uring_cqe *IoUring::peek_cqe()
+{
+	uint head = *cq_head;
+	if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+		return nullptr;
+	return &cqes[head & cq_mask];
+}
+
+void IoUring::seen_cqe()
+{
+	__atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+}
+
+int IoUring::get_fd() const
+{
+	return fd;
+}
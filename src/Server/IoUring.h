@@ -0,0 +1,62 @@
+#ifndef IOURING_H
+#define IOURING_H
+
+#include <linux/io_uring.h>
+#include <sys/types.h>
+
+/**
+ * A bare io_uring instance over the raw system calls: the submission and
+ * completion rings mapped, entries handed out and reaped one by one.
+ *
+ * Not thread safe, every ring belongs to one thread.
+ */
+class IoUring
+{
+public:
+	IoUring();
+	~IoUring();
+
+	/** False when the kernel has no io_uring */
+	bool init(uint entries);
+
+	/** Zeroed, nullptr while the submission ring is full */
+	io_uring_sqe *get_sqe();
+	/**
+	 * Submits the entries the kernel hasn't taken yet and waits for wait_nr
+	 * completions, unless the submission fell short; -errno on error
+	 */
+	int submit(uint wait_nr = 0);
+	/** Takes back the entries the kernel hasn't taken yet, returns how many */
+	uint drop_unsubmitted();
+
+	/** nullptr when no completion is pending */
+	io_uring_cqe *peek_cqe();
+	void seen_cqe();
+
+	int get_fd() const;
+
+private:
+	int fd;
+
+	void *sq_ring;
+	size_t sq_ring_size;
+	void *cq_ring;
+	size_t cq_ring_size;
+	io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	uint *sq_head;
+	uint *sq_tail;
+	uint *sq_array;
+	uint sq_mask;
+	uint sq_entries;
+	/** Entries handed out, ahead of the shared tail until submitted */
+	uint sqe_tail;
+
+	uint *cq_head;
+	uint *cq_tail;
+	uint cq_mask;
+	io_uring_cqe *cqes;
+};
+
+#endif // IOURING_H
@@ -0,0 +1,126 @@
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+#include "Server/Metrics.h"
+
+/**
+ * \class Metrics
+ */
+
+namespace {
+	struct Description {
+		std::string name;
+		std::string help;
+		double scale;
+	};
+}
+
+static const std::map<Metrics::Counter, Description> counter_descriptions {
+	{Metrics::Counter::PacketsReceived, {"em_packets_received_total", "UDP datagrams received.", 1}},
+	{Metrics::Counter::BytesReceived,   {"em_bytes_received_total", "UDP bytes received.", 1}},
+	{Metrics::Counter::PacketsSent,     {"em_packets_sent_total", "UDP datagrams sent.", 1}},
+	{Metrics::Counter::BytesSent,       {"em_bytes_sent_total", "UDP bytes sent.", 1}},
+	{Metrics::Counter::PacketsDropped,  {"em_packets_dropped_total", "Datagrams rejected or ignored.", 1}},
+	{Metrics::Counter::Retransmits,     {"em_retransmits_total", "DATA datagrams sent again on RETRANSMIT.", 1}},
+	{Metrics::Counter::SendErrors,      {"em_send_errors_total", "Failed UDP sends.", 1}},
+	{Metrics::Counter::MixerTicks,      {"em_mixer_ticks_total", "Mixer ticks executed.", 1}},
+	{Metrics::Counter::RecordingDroppedBytes, {"em_recording_dropped_bytes_total", "Mixed bytes the recorder had no room for.", 1}},
+	{Metrics::Counter::SessionsResumed, {"em_sessions_resumed_total", "Clients back on their session after a RESUME.", 1}},
+	{Metrics::Counter::TraceDroppedDatagrams, {"em_trace_dropped_datagrams_total", "Received datagrams the trace had no room for.", 1}},
+};
+
+static const std::map<Metrics::Gauge, Description> gauge_descriptions {
+	{Metrics::Gauge::SendQueueDepth,      {"em_send_queue_depth", "Datagrams waiting to be sent.", 1}},
+	{Metrics::Gauge::FifoBytes,           {"em_fifo_bytes", "Bytes buffered in all client FIFOs.", 1}},
+	{Metrics::Gauge::ConnectedClients,    {"em_connected_clients", "Clients with a TCP and UDP connection.", 1}},
+	{Metrics::Gauge::ActiveClients,       {"em_active_clients", "Clients with an active FIFO in the last tick.", 1}},
+	{Metrics::Gauge::MixedClients,        {"em_mixed_clients", "Clients mixed in the last tick.", 1}},
+	{Metrics::Gauge::MixerTickDurationNs, {"em_mixer_tick_duration_seconds", "Duration of the last mixer tick.", 1e-9}},
+	{Metrics::Gauge::TxInterval,          {"em_tx_interval_seconds", "Length of the mixer tick.", 1e-3}},
+};
+
+static const std::map<Metrics::Latency, Description> latency_descriptions {
+	{Metrics::Latency::HandleReceive,  {"em_handle_receive_seconds", "Processing time of a received datagram.", 1e-9}},
+	{Metrics::Latency::QueueResidency, {"em_queue_residency_seconds", "Time from FIFO insert to mixing.", 1e-9}},
+	{Metrics::Latency::MixerTick,      {"em_mixer_tick_seconds", "Duration of a mixer tick.", 1e-9}},
+	{Metrics::Latency::MixToSend,      {"em_mix_to_send_seconds", "Time from mixing to the socket send.", 1e-9}},
+};
+
+static const double QUANTILES[] = {50, 90, 99, 99.9, 100};
+
+Metrics::Metrics() :
+	latencies(new Histogram[(size_t) Latency::Count])
+{
+	for (CounterSlot &slot : counters)
+		slot.value.store(0, std::memory_order_relaxed);
+	for (GaugeSlot &slot : gauges)
+		slot.value.store(0, std::memory_order_relaxed);
+}
+
+Histogram &Metrics::get_histogram(Latency latency)
+{
+	return latencies[(size_t) latency];
+}
+
+uint64_t Metrics::get(Counter counter) const
+{
+	return counters[(size_t) counter].value.load(std::memory_order_relaxed);
+}
+
+int64_t Metrics::get(Gauge gauge) const
+{
+	return gauges[(size_t) gauge].value.load(std::memory_order_relaxed);
+}
+
+std::string Metrics::to_prometheus() const
+{
+	std::ostringstream ss;
+
+	for (auto p : counter_descriptions) {
+		ss << "# HELP " << p.second.name << " " << p.second.help << "\n"
+		   << "# TYPE " << p.second.name << " counter\n"
+		   << p.second.name << " " << get(p.first) << "\n";
+	}
+
+	for (auto p : gauge_descriptions) {
+		ss << "# HELP " << p.second.name << " " << p.second.help << "\n"
+		   << "# TYPE " << p.second.name << " gauge\n"
+		   << p.second.name << " ";
+		if (p.second.scale == 1)
+			ss << get(p.first) << "\n";
+		else
+			ss << get(p.first) * p.second.scale << "\n";
+	}
+
+	for (auto p : latency_descriptions) {
+		Histogram::Snapshot snapshot = latencies[(size_t) p.first].get_snapshot();
+		ss << "# HELP " << p.second.name << " " << p.second.help << "\n"
+		   << "# TYPE " << p.second.name << " summary\n";
+		for (double q : QUANTILES)
+			ss << p.second.name << "{quantile=\"" << q / 100 << "\"} "
+			   << snapshot.get_percentile(q) * p.second.scale << "\n";
+		ss << p.second.name << "_sum " << snapshot.get_sum() * p.second.scale << "\n"
+		   << p.second.name << "_count " << snapshot.get_count() << "\n";
+	}
+
+	return ss.str();
+}
+
+std::string Metrics::get_latency_report() const
+{
+	std::ostringstream ss;
+
+	for (auto p : latency_descriptions) {
+		Histogram::Snapshot snapshot = latencies[(size_t) p.first].get_snapshot();
+		ss << p.second.name << ": count " << snapshot.get_count();
+		for (double q : QUANTILES) {
+			std::ostringstream value;
+			value << std::fixed << std::setprecision(1) << snapshot.get_percentile(q) / 1000.0;
+			ss << ", p" << q << " " << value.str() << "us";
+		}
+		ss << "\n";
+	}
+
+	return ss.str();
+}
@@ -0,0 +1,100 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "System/Histogram.h"
+
+/**
+ * Counters and gauges updated from the hot paths of the server.
+ *
+ * Every value lives on its own cache line and is updated with relaxed atomics,
+ * so the receive, mixer and send threads never contend on a lock or share a line.
+ * Latencies are recorded in nanoseconds into per-thread sharded histograms.
+ */
+class Metrics
+{
+public:
+	enum class Counter : uint8_t {
+		PacketsReceived,
+		BytesReceived,
+		PacketsSent,
+		BytesSent,
+		PacketsDropped,
+		Retransmits,
+		SendErrors,
+		MixerTicks,
+		RecordingDroppedBytes,
+		SessionsResumed,
+		TraceDroppedDatagrams,
+
+		Count,
+	};
+
+	enum class Gauge : uint8_t {
+		SendQueueDepth,
+		FifoBytes,
+		ConnectedClients,
+		ActiveClients,
+		MixedClients,
+		MixerTickDurationNs,
+		TxInterval,
+
+		Count,
+	};
+
+	enum class Latency : uint8_t {
+		HandleReceive,
+		QueueResidency,
+		MixerTick,
+		MixToSend,
+
+		Count,
+	};
+
+	Metrics();
+
+	void add(Counter counter, uint64_t value = 1)
+	{
+		counters[(size_t) counter].value.fetch_add(value, std::memory_order_relaxed);
+	}
+
+	void set(Gauge gauge, int64_t value)
+	{
+		gauges[(size_t) gauge].value.store(value, std::memory_order_relaxed);
+	}
+
+	void record(Latency latency, uint64_t ns)
+	{
+		latencies[(size_t) latency].record(ns);
+	}
+
+	Histogram &get_histogram(Latency latency);
+
+	uint64_t get(Counter counter) const;
+	int64_t get(Gauge gauge) const;
+
+	std::string to_prometheus() const;
+	std::string get_latency_report() const;
+
+private:
+	static const size_t CACHE_LINE_SIZE = 64;
+
+	struct alignas(CACHE_LINE_SIZE) CounterSlot {
+		std::atomic<uint64_t> value;
+	};
+
+	struct alignas(CACHE_LINE_SIZE) GaugeSlot {
+		std::atomic<int64_t> value;
+	};
+
+	CounterSlot counters[(size_t) Counter::Count];
+	GaugeSlot   gauges[(size_t) Gauge::Count];
+
+	std::unique_ptr<Histogram[]> latencies;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,83 @@
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+
+#include "Server/MetricsServer.h"
+#include "System/Logging.h"
+
+/**
+ * \class MetricsServer
+ */
+
+const size_t MetricsServer::REQUEST_BUFFER_SIZE;
+
+MetricsServer::MetricsServer(
+	boost::asio::io_service &io_service,
+	uint port,
+	std::function<std::string(void)> report) :
+
+	io_service(io_service),
+	acceptor(io_service),
+	port(port),
+	report(report)
+{}
+
+void MetricsServer::start()
+{
+	boost::asio::ip::tcp::endpoint endpoint(
+		boost::asio::ip::address_v4::loopback(), port);
+
+	acceptor.open(endpoint.protocol());
+	acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+	acceptor.bind(endpoint);
+	acceptor.listen();
+
+	EM_WARN << "Serving metrics on 127.0.0.1:" << port << ".\n";
+	start_accept();
+}
+
+void MetricsServer::start_accept()
+{
+	SocketPointer socket = boost::make_shared<boost::asio::ip::tcp::socket>(io_service);
+	acceptor.async_accept(*socket,
+		boost::bind(&MetricsServer::handle_accept, this, socket,
+			boost::asio::placeholders::error));
+}
+
+void MetricsServer::handle_accept(SocketPointer socket, const boost::system::error_code &error)
+{
+	if (error) {
+		EM_WARN << "MetricsServer::handle_accept: error\n";
+	} else {
+		boost::shared_ptr<std::string> buffer =
+			boost::make_shared<std::string>(REQUEST_BUFFER_SIZE, '\0');
+		/** The request itself is irrelevant, every path gets the same report */
+		socket->async_read_some(boost::asio::buffer(&(*buffer)[0], buffer->size()),
+			boost::bind(&MetricsServer::handle_request, this, socket, buffer,
+				boost::asio::placeholders::error));
+	}
+	start_accept();
+}
+
+void MetricsServer::handle_request(
+	SocketPointer socket,
+	boost::shared_ptr<std::string> buffer,
+	const boost::system::error_code &error)
+{
+	if (error)
+		return;
+
+	std::string body = report();
+	*buffer = std::string("HTTP/1.0 200 OK\r\n") +
+		"Content-Type: text/plain; version=0.0.4\r\n" +
+		"Content-Length: " + std::to_string(body.size()) + "\r\n" +
+		"Connection: close\r\n" +
+		"\r\n" + body;
+
+	/** The buffer and the socket live until the write handler is destroyed */
+	boost::asio::async_write(*socket, boost::asio::buffer(*buffer),
+		[socket, buffer](const boost::system::error_code &, size_t) {
+			boost::system::error_code ignored;
+			socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+			socket->close(ignored);
+		});
+}
@@ -0,0 +1,42 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <boost/asio.hpp>
+#include <boost/shared_ptr.hpp>
+#include <functional>
+#include <string>
+
+/**
+ * Serves the server metrics in the Prometheus text format over HTTP.
+ * Listens on the loopback interface only.
+ */
+class MetricsServer
+{
+public:
+	MetricsServer(
+		boost::asio::io_service &io_service,
+		uint port,
+		std::function<std::string(void)> report);
+
+	void start();
+
+private:
+	typedef boost::shared_ptr<boost::asio::ip::tcp::socket> SocketPointer;
+
+	void start_accept();
+	void handle_accept(SocketPointer socket, const boost::system::error_code &error);
+	void handle_request(
+		SocketPointer socket,
+		boost::shared_ptr<std::string> buffer,
+		const boost::system::error_code &error);
+
+	boost::asio::io_service &io_service;
+	boost::asio::ip::tcp::acceptor acceptor;
+	uint port;
+
+	std::function<std::string(void)> report;
+
+	static const size_t REQUEST_BUFFER_SIZE = 1024;
+};
+
+#endif // METRICSSERVER_H
@@ -1,9 +1,12 @@
+#include <algorithm>
 #include <limits>
 
 #include "System/Logging.h"
 #include "Server/Mixer.h"
 #include "System/Utils.h"
 
+const size_t Mixer::BLOCK_SAMPLES;
+
 void Mixer::mixer(
 	Mixer::MixerInput *inputs,
 	size_t queues_number,
@@ -13,22 +16,59 @@ void Mixer::mixer(
 {
 	*output_size = DATA_MS_SIZE * tx_interval_ms;
 
-	for (size_t in = 0; in < queues_number; ++in)
-		inputs[in].consumed = 0;
+	consume(inputs, queues_number, *output_size);
+	mix_range(inputs, queues_number, output_buffer, 0, *output_size / sizeof(EM::data_t));
+}
+
+void Mixer::consume(Mixer::MixerInput *inputs, size_t queues_number, size_t output_size)
+{
+	for (size_t in = 0; in < queues_number; ++in) {
+		size_t length = inputs[in].length - inputs[in].length % sizeof(EM::data_t);
+		inputs[in].consumed = std::min(length, output_size - output_size % sizeof(EM::data_t));
+	}
+}
+
+void Mixer::mix_range(
+	const Mixer::MixerInput *inputs,
+	size_t queues_number,
+	void *output_buffer,
+	size_t first,
+	size_t last)
+{
+	/** Input by input over a block, the inner loop vectorizes */
+	int32_t sums[BLOCK_SAMPLES];
+	for (size_t begin = first; begin < last; begin += BLOCK_SAMPLES) {
+		size_t end = std::min(begin + BLOCK_SAMPLES, last);
+		std::fill(sums, sums + (end - begin), 0);
 
-	for (size_t i = 0; i < *output_size / sizeof(EM::data_t); ++i) {
-		int32_t sum = 0;
 		for (size_t in = 0; in < queues_number; ++in) {
-			if (inputs[in].consumed + sizeof(EM::data_t) <= inputs[in].length) {
-				sum += ((EM::data_t *) inputs[in].data)[i];
-				inputs[in].consumed += sizeof(EM::data_t);
-			}
+			const EM::data_t *input = (const EM::data_t *) inputs[in].data;
+			size_t available = std::min(end, inputs[in].length / sizeof(EM::data_t));
+			for (size_t i = begin; i < available; ++i)
+				sums[i - begin] += input[i];
 		}
 
-		if (sum > (int32_t) std::numeric_limits<EM::data_t>::max())
-			sum = (int32_t) std::numeric_limits<EM::data_t>::max();
-		if (sum < (int32_t) std::numeric_limits<EM::data_t>::min())
-			sum = (int32_t) std::numeric_limits<EM::data_t>::min();
-		((EM::data_t *) output_buffer)[i] = (EM::data_t) sum;
+		EM::data_t *output = (EM::data_t *) output_buffer;
+		for (size_t i = begin; i < end; ++i) {
+			int32_t sum = sums[i - begin];
+			if (sum > (int32_t) std::numeric_limits<EM::data_t>::max())
+				sum = (int32_t) std::numeric_limits<EM::data_t>::max();
+			if (sum < (int32_t) std::numeric_limits<EM::data_t>::min())
+				sum = (int32_t) std::numeric_limits<EM::data_t>::min();
+			output[i] = (EM::data_t) sum;
+		}
 	}
 }
+
+uint64_t Mixer::get_energy(const void *data, size_t length)
+{
+	size_t samples = length / sizeof(EM::data_t);
+	if (samples == 0)
+		return 0;
+
+	const EM::data_t *input = (const EM::data_t *) data;
+	uint64_t sum = 0;
+	for (size_t i = 0; i < samples; ++i)
+		sum += (int32_t) input[i] * input[i];
+	return sum / samples;
+}
@@ -23,6 +23,26 @@ public:
 		size_t *output_size,
 		unsigned long tx_interval_ms);
 
+	/** Marks what a mix of output_size bytes takes from every input */
+	static void consume(MixerInput *inputs, size_t queues_number, size_t output_size);
+
+	/**
+	 * The samples [first, last) of the mix only, consumed is left alone, so
+	 * disjoint ranges can be mixed from different threads
+	 */
+	static void mix_range(
+		const MixerInput *inputs,
+		size_t queues_number,
+		void *output_buffer,
+		size_t first,
+		size_t last);
+
+	/** Samples summed at once, the sums fit in the cache */
+	static const size_t BLOCK_SAMPLES = 256;
+
+	/** Mean square of the samples */
+	static uint64_t get_energy(const void *data, size_t length);
+
 private:
 	Mixer() = delete;
 };
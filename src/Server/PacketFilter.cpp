@@ -0,0 +1,125 @@
+#include <sys/socket.h>
+
+#include "Server/PacketFilter.h"
+#include "System/Logging.h"
+#include "System/Messages.h"
+
+/**
+ * \class PacketFilter
+ */
+
+const size_t PacketFilter::MAX_SOURCES;
+
+namespace {
+	/** A UDP socket filter sees the datagram from its UDP header on */
+	const uint32_t PAYLOAD_OFFSET = 8;
+	const uint32_t SOURCE_OFFSET  = SKF_NET_OFF + 12;
+
+	/** Whatever the kernel takes as the whole datagram */
+	const uint32_t ACCEPT = 0xffffffff;
+
+	uint32_t get_prefix(const std::string &header)
+	{
+		return ((uint32_t) (unsigned char) header[0] << 24)
+			| ((uint32_t) (unsigned char) header[1] << 16)
+			| ((uint32_t) (unsigned char) header[2] << 8)
+			| (uint32_t) (unsigned char) header[3];
+	}
+}
+
+PacketFilter::PacketFilter(int fd, Level level) :
+	fd(fd),
+	level(level)
+{}
+
+bool PacketFilter::attach()
+{
+	if (level == Level::Off)
+		return true;
+
+	std::vector<sock_filter> program = build();
+	sock_fprog fprog;
+	fprog.len    = program.size();
+	fprog.filter = &program[0];
+
+	if (::setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) != 0) {
+		EM_WARN << "Unable to attach the packet filter.\n";
+		level = Level::Off;
+		return false;
+	}
+
+	EM_DEBUG << "Packet filter of " << program.size() << " instructions, "
+		<< sources.size() << " sources.\n";
+	return true;
+}
+
+void PacketFilter::add_source(uint cid, const boost::asio::ip::address &address)
+{
+	if (level != Level::Sources || !address.is_v4())
+		return;
+
+	remove_source(cid);
+	uint32_t source = address.to_v4().to_ulong();
+	client_addresses[cid] = source;
+	if (sources[source]++ == 0)
+		attach();
+}
+
+void PacketFilter::remove_source(uint cid)
+{
+	auto client_address = client_addresses.find(cid);
+	if (client_address == client_addresses.end())
+		return;
+
+	auto source = sources.find(client_address->second);
+	client_addresses.erase(client_address);
+	if (--source->second == 0) {
+		sources.erase(source);
+		attach();
+	}
+}
+
+std::vector<sock_filter> PacketFilter::build() const
+{
+	/** The server never receives DATA or ACK, only what a client sends */
+	static const std::vector<std::string> HEADERS = {
+		EM::Messages::Headers::Client,
+		EM::Messages::Headers::Upload,
+		EM::Messages::Headers::Retransmit,
+		EM::Messages::Headers::KeepAlive,
+		EM::Messages::Headers::Trunk,
+		EM::Messages::Headers::Resume,
+	};
+
+	std::vector<sock_filter> program;
+
+	if (level == Level::Sources && sources.size() <= MAX_SOURCES) {
+		/** RESUME comes from wherever the client moved to, its token is checked later */
+		program.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, PAYLOAD_OFFSET));
+		program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+			get_prefix(EM::Messages::Headers::Resume), 0, 1));
+		program.push_back(BPF_STMT(BPF_RET | BPF_K, ACCEPT));
+
+		/** Far jumps only go forward by ja, so each address takes two instructions */
+		program.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SOURCE_OFFSET));
+		size_t remaining = sources.size();
+		for (const std::pair<const uint32_t, uint> &source : sources) {
+			--remaining;
+			program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, source.first, 0, 1));
+			program.push_back(BPF_JUMP(BPF_JMP | BPF_JA, (uint32_t) (2 * remaining + 1), 0, 0));
+		}
+		program.push_back(BPF_STMT(BPF_RET | BPF_K, 0));
+	} else if (level == Level::Sources) {
+		EM_WARN << "Over " << MAX_SOURCES << " sources, filtering headers only.\n";
+	}
+
+	/** Shorter datagrams fail the load and are dropped as well */
+	program.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, PAYLOAD_OFFSET));
+	for (size_t i = 0; i < HEADERS.size(); ++i)
+		program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, get_prefix(HEADERS[i]),
+			(uint8_t) (HEADERS.size() - i), 0));
+	program.push_back(BPF_STMT(BPF_RET | BPF_K, 0));
+	program.push_back(BPF_STMT(BPF_RET | BPF_K, ACCEPT));
+
+	return program;
+}
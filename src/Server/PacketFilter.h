@@ -0,0 +1,49 @@
+#ifndef PACKETFILTER_H
+#define PACKETFILTER_H
+
+#include <boost/asio.hpp>
+#include <linux/filter.h>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * A classic BPF program on the server's UDP socket, so junk is dropped in the
+ * kernel before it is copied out and parsed.
+ *
+ * At the Headers level a datagram has to start like one of the messages a server
+ * receives. At the Sources level it also has to come from the address of a TCP
+ * connection, the list is rebuilt and the program swapped whenever one opens or
+ * goes away; RESUME alone passes from anywhere, a roaming client sends it before
+ * its new address has a connection. Too many addresses for one program fall back
+ * to the Headers level.
+ *
+ * Used only from the io_service thread.
+ */
+class PacketFilter
+{
+public:
+	enum class Level : uint8_t {Off, Headers, Sources};
+
+	PacketFilter(int fd, Level level);
+
+	/** False if the kernel refused the program, the socket then stays unfiltered */
+	bool attach();
+
+	void add_source(uint cid, const boost::asio::ip::address &address);
+	void remove_source(uint cid);
+
+	static const size_t MAX_SOURCES = 1024;
+
+private:
+	std::vector<sock_filter> build() const;
+
+	int fd;
+	Level level;
+
+	std::unordered_map<uint, uint32_t> client_addresses;
+	/** IPv4 addresses in host order, with the clients behind each */
+	std::map<uint32_t, uint> sources;
+};
+
+#endif // PACKETFILTER_H
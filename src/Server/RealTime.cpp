@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "Server/RealTime.h"
+#include "System/Logging.h"
+
+/**
+ * \class RealTime
+ */
+
+const size_t RealTime::STACK_PREFAULT_SIZE;
+
+namespace {
+	const char *get_name(RealTime::Role role)
+	{
+		switch (role) {
+			case RealTime::Role::Mixer:  return "em-mixer";
+			case RealTime::Role::Send:   return "em-send";
+			case RealTime::Role::Worker: return "em-worker";
+			default:                     return "em-info";
+		}
+	}
+}
+
+RealTime::RealTime(const std::vector<uint> &cpus, uint priority) :
+	cpus(cpus),
+	priority(priority)
+{}
+
+bool RealTime::is_enabled() const
+{
+	return !cpus.empty() || priority > 0;
+}
+
+void RealTime::lock_memory()
+{
+	if (!is_enabled())
+		return;
+
+	/** Freed memory stays in the heap, so it doesn't fault again when reused */
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+		EM_WARN << "Unable to lock the memory (" << std::strerror(errno)
+		        << "), raise RLIMIT_MEMLOCK or grant CAP_IPC_LOCK.\n";
+	else
+		EM_WARN << "Memory locked.\n";
+}
+
+void RealTime::setup_thread(Role role, size_t index)
+{
+	/** The mixer is the main thread, its name is the process' one that tools look for */
+	if (role != Role::Mixer)
+		pthread_setname_np(pthread_self(), get_name(role));
+	if (!is_enabled())
+		return;
+
+	if (!cpus.empty()) {
+		uint cpu = cpus[((size_t) role + index) % cpus.size()];
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+
+		int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		if (error != 0)
+			EM_WARN << "Unable to pin " << get_name(role) << " to core " << cpu
+			        << " (" << std::strerror(error) << ").\n";
+		else
+			EM_LOG << "Pinned " << get_name(role) << " to core " << cpu << ".\n";
+	}
+
+	/** The mixer and its workers, the send thread spins and would starve its core */
+	if ((role == Role::Mixer || role == Role::Worker) && priority > 0) {
+		sched_param param;
+		std::memset(&param, 0, sizeof(param));
+		param.sched_priority = std::min((int) priority, sched_get_priority_max(SCHED_FIFO));
+
+		int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		if (error != 0)
+			EM_WARN << "Unable to run " << get_name(role) << " under SCHED_FIFO (" << std::strerror(error)
+			        << "), raise RLIMIT_RTPRIO or grant CAP_SYS_NICE.\n";
+		else
+			EM_WARN << get_name(role) << " under SCHED_FIFO, priority " << param.sched_priority << ".\n";
+	}
+
+	prefault_stack();
+}
+
+void RealTime::prefault_stack()
+{
+	/** Touched once, so the first deep call in a tick doesn't fault */
+	char stack[STACK_PREFAULT_SIZE];
+	volatile char *page = stack;
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	for (size_t i = 0; i < STACK_PREFAULT_SIZE; i += page_size)
+		page[i] = 0;
+}
@@ -0,0 +1,41 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Keeps the server's threads out of the way of other work on the host: names
+ * them, pins them to the given cores, runs the mixer under SCHED_FIFO and locks
+ * the memory, so that a tick isn't late because of the scheduler or a page fault.
+ *
+ * Every step stands alone, one refused for lack of privileges is reported and
+ * the server runs on without it.
+ */
+class RealTime
+{
+public:
+	enum class Role : uint8_t {Mixer, Send, Info, Worker};
+
+	/** No cores and priority 0 leave everything but the names as it was */
+	RealTime(const std::vector<uint> &cpus, uint priority);
+
+	bool is_enabled() const;
+
+	/** Once, after the buffers are allocated and before the threads start */
+	void lock_memory();
+
+	/** From the thread itself, when it starts; workers take the cores after the info thread */
+	void setup_thread(Role role, size_t index = 0);
+
+	static const size_t STACK_PREFAULT_SIZE = 256 * 1024;
+
+private:
+	void prefault_stack();
+
+	std::vector<uint> cpus;
+	uint priority;
+};
+
+#endif // REALTIME_H
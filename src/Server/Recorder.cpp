@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "Server/Recorder.h"
+#include "System/Logging.h"
+#include "System/Utils.h"
+
+/**
+ * \class Recorder
+ */
+
+const size_t Recorder::RING_SIZE;
+const size_t Recorder::WRITE_SIZE;
+const size_t Recorder::PREALLOCATE_SIZE;
+const uint Recorder::WRITER_INTERVAL_MS;
+
+namespace {
+	const size_t WAV_HEADER_SIZE = 44;
+
+	void put_le(char *destination, uint32_t value, size_t bytes)
+	{
+		for (size_t i = 0; i < bytes; ++i)
+			destination[i] = (char) ((value >> (8 * i)) & 0xff);
+	}
+}
+
+Recorder::Recorder(const std::string &path) :
+	path(path),
+	wav(path.size() >= 4 && path.compare(path.size() - 4, 4, ".wav") == 0),
+	fd(-1),
+
+	ring(nullptr),
+	head(0),
+	tail(0),
+
+	dropped(0),
+	stopping(false),
+
+	file_offset(0),
+	allocated(0)
+{}
+
+Recorder::~Recorder()
+{
+	stop();
+	std::free(ring);
+}
+
+bool Recorder::start()
+{
+	fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		EM_ERROR << "Unable to open " << path << " for recording.\n";
+		return false;
+	}
+
+	if (posix_memalign((void **) &ring, sysconf(_SC_PAGESIZE), RING_SIZE) != 0) {
+		::close(fd);
+		fd = -1;
+		return false;
+	}
+
+	if (wav) {
+		write_wav_header(0);
+		file_offset = WAV_HEADER_SIZE;
+	}
+
+	EM_WARN << "Recording to " << path << ".\n";
+	writer = std::thread(&Recorder::writer_routine, this);
+	return true;
+}
+
+void Recorder::stop()
+{
+	if (!writer.joinable())
+		return;
+
+	stopping.store(true, std::memory_order_release);
+	writer.join();
+
+	if (wav)
+		write_wav_header(file_offset - WAV_HEADER_SIZE);
+	/** Drops the preallocated tail */
+	if (::ftruncate(fd, file_offset) != 0)
+		EM_WARN << "Unable to truncate " << path << ".\n";
+	::close(fd);
+	fd = -1;
+
+	EM_WARN << "Recorded " << get_recorded_bytes() << " bytes to " << path
+		<< ", dropped " << get_dropped_bytes() << ".\n";
+}
+
+bool Recorder::record(const char *data, size_t length)
+{
+	uint64_t position = head.load(std::memory_order_relaxed);
+	if (position + length - tail.load(std::memory_order_acquire) > RING_SIZE) {
+		dropped.fetch_add(length, std::memory_order_relaxed);
+		return false;
+	}
+
+	size_t offset = position % RING_SIZE;
+	size_t first  = std::min(length, RING_SIZE - offset);
+	std::memcpy(ring + offset, data, first);
+	std::memcpy(ring, data + first, length - first);
+
+	head.store(position + length, std::memory_order_release);
+	return true;
+}
+
+uint64_t Recorder::get_recorded_bytes() const
+{
+	return tail.load(std::memory_order_acquire);
+}
+
+uint64_t Recorder::get_dropped_bytes() const
+{
+	return dropped.load(std::memory_order_relaxed);
+}
+
+void Recorder::writer_routine()
+{
+	pthread_setname_np(pthread_self(), "em-recorder");
+	while (true) {
+		bool finishing = stopping.load(std::memory_order_acquire);
+		uint64_t available = head.load(std::memory_order_acquire)
+			- tail.load(std::memory_order_relaxed);
+
+		/** Whole blocks only, so every write starts on a block of the ring */
+		while (available >= WRITE_SIZE) {
+			if (!write_block(WRITE_SIZE))
+				return;
+			available -= WRITE_SIZE;
+		}
+
+		if (finishing) {
+			if (available > 0)
+				write_block(available);
+			return;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_INTERVAL_MS));
+	}
+}
+
+bool Recorder::write_block(size_t length)
+{
+	if (file_offset + length > allocated) {
+		allocated = file_offset + length + PREALLOCATE_SIZE;
+		/** Not every file system supports it, it only saves block allocation */
+		posix_fallocate(fd, file_offset, allocated - file_offset);
+	}
+
+	uint64_t position = tail.load(std::memory_order_relaxed);
+	const char *block = ring + position % RING_SIZE;
+
+	size_t written = 0;
+	while (written < length) {
+		ssize_t result = ::pwrite(fd, block + written, length - written, file_offset + written);
+		if (result < 0) {
+			EM_ERROR << "Recording to " << path << " failed.\n";
+			return false;
+		}
+		written += result;
+	}
+
+	file_offset += length;
+	tail.store(position + length, std::memory_order_release);
+	return true;
+}
+
+void Recorder::write_wav_header(uint64_t data_size)
+{
+	static const uint BITS = 8 * sizeof(EM::data_t);
+	uint32_t size = (uint32_t) std::min<uint64_t>(data_size, UINT32_MAX - WAV_HEADER_SIZE);
+
+	char header[WAV_HEADER_SIZE];
+	std::memcpy(header, "RIFF", 4);
+	put_le(header + 4, size + WAV_HEADER_SIZE - 8, 4);
+	std::memcpy(header + 8, "WAVEfmt ", 8);
+	put_le(header + 16, 16, 4);
+	put_le(header + 20, 1, 2);
+	put_le(header + 22, EM::Default::CHANNELS, 2);
+	put_le(header + 24, EM::Default::SAMPLE_RATE, 4);
+	put_le(header + 28, EM::Default::SAMPLE_RATE * EM::Default::CHANNELS * BITS / 8, 4);
+	put_le(header + 32, EM::Default::CHANNELS * BITS / 8, 2);
+	put_le(header + 34, BITS, 2);
+	std::memcpy(header + 36, "data", 4);
+	put_le(header + 40, size, 4);
+
+	if (::pwrite(fd, header, WAV_HEADER_SIZE, 0) != (ssize_t) WAV_HEADER_SIZE)
+		EM_WARN << "Unable to write the WAV header of " << path << ".\n";
+}
@@ -0,0 +1,64 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+/**
+ * Records the mixed stream to a file without ever blocking the mixer.
+ *
+ * The mixer copies each tick into a single-producer, single-consumer ring; a
+ * writer thread empties it in large writes from page-aligned memory into a file
+ * preallocated ahead of the data. Ticks that find the ring full are dropped and
+ * counted rather than waited for. Files named *.wav get a WAV header, which is
+ * completed on stop(); anything else is raw PCM.
+ */
+class Recorder
+{
+public:
+	Recorder(const std::string &path);
+	~Recorder();
+
+	/** False if the file could not be opened */
+	bool start();
+	void stop();
+
+	/** Mixer side, never blocks; false when the data had to be dropped */
+	bool record(const char *data, size_t length);
+
+	uint64_t get_recorded_bytes() const;
+	uint64_t get_dropped_bytes() const;
+
+	static const size_t RING_SIZE        = 1 << 22;
+	static const size_t WRITE_SIZE       = 1 << 16;
+	static const size_t PREALLOCATE_SIZE = 1 << 24;
+	static const uint WRITER_INTERVAL_MS = 20;
+
+private:
+	void writer_routine();
+	bool write_block(size_t length);
+	void write_wav_header(uint64_t data_size);
+
+	std::string path;
+	bool wav;
+	int fd;
+
+	char *ring;
+	/** Written only by the mixer and the writer respectively, apart on their own lines */
+	std::atomic<uint64_t> head;
+	char head_padding[64 - sizeof(std::atomic<uint64_t>)];
+	std::atomic<uint64_t> tail;
+	char tail_padding[64 - sizeof(std::atomic<uint64_t>)];
+
+	std::atomic<uint64_t> dropped;
+	std::atomic<bool> stopping;
+	std::thread writer;
+
+	/** Writer thread only */
+	uint64_t file_offset;
+	uint64_t allocated;
+};
+
+#endif // RECORDER_H
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "Server/Resampler.h"
+#include "System/Utils.h"
+
+/**
+ * \class Resampler
+ */
+
+const size_t Resampler::TAPS;
+const size_t Resampler::PHASES;
+
+Resampler::Resampler(
+	uint input_rate,
+	uint input_channels,
+	uint output_rate,
+	uint output_channels) :
+
+	input_rate(input_rate),
+	input_channels(input_channels),
+	output_rate(output_rate),
+	output_channels(output_channels),
+
+	step((double) input_rate / output_rate),
+	ratio_adjustment(1.0),
+
+	buffers(output_channels, std::vector<float>(TAPS / 2, 0.0f)),
+	position(0),
+
+	next_buffers(output_channels),
+	next_position(0)
+{
+	assert(input_rate > 0 && output_rate > 0);
+	assert(input_channels > 0 && output_channels > 0);
+	build_filter();
+}
+
+std::string Resampler::process(const std::string &input)
+{
+	std::string output = prepare(input);
+	commit();
+	return output;
+}
+
+std::string Resampler::prepare(const std::string &input)
+{
+	std::string data = remainder + input;
+	size_t frame_size = input_channels * sizeof(EM::data_t);
+	size_t frames = data.size() / frame_size;
+	next_remainder = data.substr(frames * frame_size);
+
+	/** Deinterleave, mapping the input channels onto the output ones */
+	const EM::data_t *samples = (const EM::data_t *) data.data();
+	for (uint c = 0; c < output_channels; ++c) {
+		std::vector<float> &buffer = next_buffers[c];
+		buffer.assign(buffers[c].begin(), buffers[c].end());
+		size_t offset = buffer.size();
+		buffer.resize(offset + frames);
+
+		for (size_t i = 0; i < frames; ++i) {
+			const EM::data_t *frame = samples + i * input_channels;
+			if (output_channels == 1 && input_channels > 1) {
+				float sum = 0;
+				for (uint in = 0; in < input_channels; ++in)
+					sum += frame[in];
+				buffer[offset + i] = sum / input_channels;
+			} else {
+				buffer[offset + i] = frame[std::min(c, input_channels - 1)];
+			}
+		}
+	}
+
+	size_t available = next_buffers[0].size();
+	double increment = step * ratio_adjustment;
+	double position = this->position;
+
+	std::string output;
+	output.reserve((size_t) ((available / increment + 1) * output_channels * sizeof(EM::data_t)));
+
+	while ((size_t) position + TAPS <= available) {
+		size_t index = (size_t) position;
+		double fraction = position - index;
+
+		for (uint c = 0; c < output_channels; ++c) {
+			float value = filter(&next_buffers[c][index], fraction);
+			value = std::max(value, (float) std::numeric_limits<EM::data_t>::min());
+			value = std::min(value, (float) std::numeric_limits<EM::data_t>::max());
+			EM::data_t sample = (EM::data_t) std::lrint(value);
+			output.append((const char *) &sample, sizeof(sample));
+		}
+
+		position += increment;
+	}
+
+	size_t consumed = std::min((size_t) position, available);
+	for (std::vector<float> &buffer : next_buffers)
+		buffer.erase(buffer.begin(), buffer.begin() + consumed);
+	next_position = position - consumed;
+
+	return output;
+}
+
+void Resampler::commit()
+{
+	buffers.swap(next_buffers);
+	position = next_position;
+	remainder.swap(next_remainder);
+}
+
+void Resampler::set_ratio_adjustment(double ratio_adjustment)
+{
+	this->ratio_adjustment = ratio_adjustment;
+}
+
+double Resampler::get_ratio_adjustment() const
+{
+	return ratio_adjustment;
+}
+
+uint Resampler::get_input_rate() const
+{
+	return input_rate;
+}
+
+uint Resampler::get_input_channels() const
+{
+	return input_channels;
+}
+
+void Resampler::build_filter()
+{
+	/** Cut below the lower of the two Nyquist frequencies, with some margin */
+	double cutoff = 0.5 * std::min(1.0, (double) output_rate / input_rate) * 0.95;
+	double half = TAPS / 2.0;
+
+	coefficients.assign((PHASES + 1) * TAPS, 0.0f);
+	for (size_t p = 0; p <= PHASES; ++p) {
+		double center = half - 1 + (double) p / PHASES;
+		double sum = 0;
+
+		for (size_t k = 0; k < TAPS; ++k) {
+			double x = k - center;
+			double sinc = x == 0 ? 1.0 : std::sin(2 * M_PI * cutoff * x) / (2 * M_PI * cutoff * x);
+			double window = 0.42 + 0.5 * std::cos(M_PI * x / half)
+				+ 0.08 * std::cos(2 * M_PI * x / half);
+			double value = std::fabs(x) >= half ? 0.0 : 2 * cutoff * sinc * window;
+
+			coefficients[p * TAPS + k] = (float) value;
+			sum += value;
+		}
+
+		/** Unity gain at DC for every phase */
+		for (size_t k = 0; k < TAPS; ++k)
+			coefficients[p * TAPS + k] /= (float) sum;
+	}
+}
+
+float Resampler::filter(const float *samples, double fraction) const
+{
+	static const size_t LANES = 8;
+
+	double phase = fraction * PHASES;
+	size_t index = (size_t) phase;
+	float weight = (float) (phase - index);
+
+	const float *first  = &coefficients[index * TAPS];
+	const float *second = first + TAPS;
+
+	/** Independent lanes, so the loop vectorizes without reassociating floats */
+	float first_sum[LANES]  = {0};
+	float second_sum[LANES] = {0};
+	for (size_t k = 0; k < TAPS; k += LANES) {
+		for (size_t lane = 0; lane < LANES; ++lane) {
+			first_sum[lane]  += samples[k + lane] * first[k + lane];
+			second_sum[lane] += samples[k + lane] * second[k + lane];
+		}
+	}
+
+	float y0 = 0, y1 = 0;
+	for (size_t lane = 0; lane < LANES; ++lane) {
+		y0 += first_sum[lane];
+		y1 += second_sum[lane];
+	}
+
+	return y0 + (y1 - y0) * weight;
+}
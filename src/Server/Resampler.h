@@ -0,0 +1,67 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Converts interleaved 16-bit PCM between sample rates and channel counts.
+ *
+ * A windowed-sinc polyphase filter with a fixed number of phases, interpolated
+ * between neighbouring phases, so any ratio works and the ratio can be nudged
+ * while running. The inner loops are plain dot products over contiguous floats
+ * and are left to the compiler to vectorize.
+ */
+class Resampler
+{
+public:
+	Resampler(uint input_rate, uint input_channels, uint output_rate, uint output_channels);
+
+	std::string process(const std::string &input);
+
+	/**
+	 * Converts without moving on: the history, position and remainder stay as
+	 * they were until commit(), so an output nobody takes costs the state nothing
+	 */
+	std::string prepare(const std::string &input);
+	void commit();
+
+	/** Multiplies the nominal input/output ratio, for fine rate corrections */
+	void set_ratio_adjustment(double ratio_adjustment);
+	double get_ratio_adjustment() const;
+
+	uint get_input_rate() const;
+	uint get_input_channels() const;
+
+	static const size_t TAPS   = 32;
+	static const size_t PHASES = 256;
+
+private:
+	void build_filter();
+	float filter(const float *samples, double position) const;
+
+	uint input_rate;
+	uint input_channels;
+	uint output_rate;
+	uint output_channels;
+
+	double step;
+	double ratio_adjustment;
+
+	/** (PHASES + 1) rows of TAPS coefficients, the extra row closes the interpolation */
+	std::vector<float> coefficients;
+
+	/** Per output channel history followed by the new input, as floats */
+	std::vector<std::vector<float> > buffers;
+	double position;
+
+	/** Bytes of an incomplete input frame, kept for the next call */
+	std::string remainder;
+
+	/** The state after the last prepare(), taken by commit() */
+	std::vector<std::vector<float> > next_buffers;
+	double next_position;
+	std::string next_remainder;
+};
+
+#endif // RESAMPLER_H
@@ -7,9 +7,7 @@
 #include "System/Messages.h"
 
 TcpConnection::~TcpConnection()
-{
-	server->on_connection_lost(cid);
-}
+{}
 
 TcpConnection::Pointer TcpConnection::create(
 	AbstractServer *server,
@@ -20,16 +18,22 @@ TcpConnection::Pointer TcpConnection::create(
 
 void TcpConnection::start()
 {
-	log() << "Starting connection...\n";
+	EM_LOG << "Starting connection...\n";
 	char msg[EM::Messages::LENGTH];
 
-	cid = server->get_next_cid();
+	cid   = server->get_next_cid();
+	token = server->get_next_token();
 
-	std::sprintf(msg, EM::Messages::Client.c_str(), cid);
+	if (token != 0)
+		std::sprintf(msg, EM::Messages::ClientSession.c_str(), cid, (unsigned long long) token);
+	else
+		std::sprintf(msg, EM::Messages::Client.c_str(), cid);
 
-	std::string message(msg, std::strlen(msg));
+	/** One write, so the greeting arrives with the CLIENT line */
+	write_queue.push_back({std::string(msg, std::strlen(msg)) + server->get_greeting(), false});
+	writing = true;
 
-	boost::asio::async_write(socket, boost::asio::buffer(message),
+	boost::asio::async_write(socket, boost::asio::buffer(write_queue.front().data),
 		boost::bind(&TcpConnection::handle_connect, shared_from_this(),
 			boost::asio::placeholders::error,
 			boost::asio::placeholders::bytes_transferred));
@@ -37,10 +41,13 @@ void TcpConnection::start()
 
 void TcpConnection::send_info(const std::string &info)
 {
-	boost::asio::async_write(socket, boost::asio::buffer(info),
-		boost::bind(&TcpConnection::handle_write, shared_from_this(),
-			boost::asio::placeholders::error,
-			boost::asio::placeholders::bytes_transferred));
+	io_service.post(boost::bind(&TcpConnection::enqueue, shared_from_this(), info, true));
+}
+
+void TcpConnection::close()
+{
+	boost::system::error_code error;
+	socket.close(error);
 }
 
 boost::asio::ip::tcp::socket &TcpConnection::get_socket()
@@ -53,6 +60,16 @@ uint TcpConnection::get_cid() const
 	return cid;
 }
 
+void TcpConnection::set_cid(uint cid)
+{
+	this->cid = cid;
+}
+
+uint64_t TcpConnection::get_token() const
+{
+	return token;
+}
+
 std::string TcpConnection::get_name() const
 {
 	std::string name;
@@ -67,19 +84,67 @@ std::string TcpConnection::get_name() const
 }
 
 TcpConnection::TcpConnection(AbstractServer *server, boost::asio::io_service &io_service) :
-	server(server), socket(io_service)
+	server(server),
+	io_service(io_service),
+	socket(io_service),
+
+	writing(false),
+	reports_dropped(0),
+
+	cid(0),
+	token(0)
 {}
 
 void TcpConnection::handle_connect(const boost::system::error_code &error, size_t size)
 {
-	if (error)
-		warn() << "handle_connect: error\n";
-	else
-		server->on_connection_established(cid, this);
+	if (error) {
+		EM_WARN << "handle_connect: error\n";
+		/** Never added as a client, so nothing else would give the cid back */
+		server->release_cid(cid);
+		return;
+	}
+
+	server->on_connection_established(cid, this);
+	handle_write(error, size);
 }
 
 void TcpConnection::handle_write(const boost::system::error_code &error, size_t size)
 {
-	if (error)
-		server->on_connection_lost(cid);
+	write_queue.pop_front();
+	writing = false;
+
+	if (error) {
+		write_queue.clear();
+		server->on_connection_lost(cid, this);
+		return;
+	}
+
+	if (!write_queue.empty())
+		write_front();
+}
+
+void TcpConnection::enqueue(const std::string &data, bool replaceable)
+{
+	/** A report is a full snapshot, so one still waiting is stale */
+	if (replaceable && !write_queue.empty() && write_queue.back().replaceable
+		&& (!writing || write_queue.size() > 1)) {
+		write_queue.back().data = data;
+		++reports_dropped;
+		EM_DEBUG << "Connection " << cid << " is slow, " << reports_dropped
+			<< " reports dropped.\n";
+		return;
+	}
+
+	write_queue.push_back({data, replaceable});
+	if (!writing)
+		write_front();
+}
+
+void TcpConnection::write_front()
+{
+	writing = true;
+	boost::asio::async_write(socket, boost::asio::buffer(write_queue.front().data),
+		boost::bind(&TcpConnection::handle_write, shared_from_this(),
+			boost::asio::placeholders::error,
+			boost::asio::placeholders::bytes_transferred));
 }
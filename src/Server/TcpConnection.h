@@ -3,6 +3,8 @@
 
 #include <boost/asio.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <deque>
+#include <string>
 
 #include "System/AbstractServer.h"
 
@@ -16,11 +18,17 @@ public:
 
 	static Pointer create(AbstractServer *server, boost::asio::io_service &io_service);
 	void start();
+	/** Safe from any thread, a report still waiting is replaced by the newer one */
 	void send_info(const std::string &info);
+	/** Only from the io_service thread */
+	void close();
 
 	boost::asio::ip::tcp::socket &get_socket();
 
 	uint get_cid() const;
+	/** A resumed session takes the connection over, only from the io_service thread */
+	void set_cid(uint cid);
+	uint64_t get_token() const;
 
 	virtual std::string get_name() const;
 
@@ -29,10 +37,27 @@ private:
 	void handle_connect(const boost::system::error_code &error, size_t size);
 	void handle_write(const boost::system::error_code &error, size_t size);
 
+	/** Writes are queued and run one at a time, only on the io_service */
+
+	struct PendingWrite {
+		std::string data;
+		bool replaceable;
+	};
+
+	void enqueue(const std::string &data, bool replaceable);
+	void write_front();
+
 	AbstractServer *server;
+	boost::asio::io_service &io_service;
 	boost::asio::ip::tcp::socket socket;
 
+	/** The front is in flight while writing is set */
+	std::deque<PendingWrite> write_queue;
+	bool writing;
+	size_t reports_dropped;
+
 	uint cid;
+	uint64_t token;
 };
 
 #endif // TCPCONNECTION_H
@@ -0,0 +1,56 @@
+#include "Server/TraceReader.h"
+#include "Server/TraceWriter.h"
+#include "System/Logging.h"
+
+/**
+ * \class TraceReader
+ */
+
+namespace {
+	uint64_t get_le(const char *source, size_t bytes)
+	{
+		uint64_t value = 0;
+		for (size_t i = 0; i < bytes; ++i)
+			value |= (uint64_t) (unsigned char) source[i] << (8 * i);
+		return value;
+	}
+}
+
+TraceReader::TraceReader(const std::string &path) :
+	path(path)
+{}
+
+bool TraceReader::open()
+{
+	file.open(path, std::ios::binary);
+	if (!file) {
+		EM_ERROR << "Unable to open " << path << ".\n";
+		return false;
+	}
+
+	std::string magic(TraceWriter::MAGIC.size(), '\0');
+	if (!file.read(&magic[0], magic.size()) || magic != TraceWriter::MAGIC) {
+		EM_ERROR << path << " is not a datagram trace.\n";
+		return false;
+	}
+	return true;
+}
+
+bool TraceReader::read(Datagram &datagram)
+{
+	char header[TraceWriter::RECORD_HEADER_SIZE];
+	if (!file.read(header, sizeof(header)))
+		return false;
+
+	datagram.time_ns  = get_le(&header[0], 8);
+	datagram.endpoint = boost::asio::ip::udp::endpoint(
+		boost::asio::ip::address_v4((uint32_t) get_le(&header[8], 4)),
+		(unsigned short) get_le(&header[12], 2));
+	datagram.data.resize(get_le(&header[14], 2));
+
+	if (!file.read(&datagram.data[0], datagram.data.size())) {
+		EM_WARN << "The trace ends in a truncated record.\n";
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,35 @@
+#ifndef TRACEREADER_H
+#define TRACEREADER_H
+
+#include <boost/asio.hpp>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+/**
+ * Reads back, in order, the datagrams traced by a TraceWriter.
+ */
+class TraceReader
+{
+public:
+	struct Datagram {
+		/** Since the start of the trace */
+		uint64_t time_ns;
+		boost::asio::ip::udp::endpoint endpoint;
+		std::string data;
+	};
+
+	TraceReader(const std::string &path);
+
+	/** False if the file is missing or not a trace */
+	bool open();
+
+	/** False at the end of the trace, or where a truncated record starts */
+	bool read(Datagram &datagram);
+
+private:
+	std::string path;
+	std::ifstream file;
+};
+
+#endif // TRACEREADER_H
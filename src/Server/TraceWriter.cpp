@@ -0,0 +1,60 @@
+#include <cstring>
+
+#include "Server/TraceWriter.h"
+#include "System/Logging.h"
+
+/**
+ * \class TraceWriter
+ */
+
+const std::string TraceWriter::MAGIC = "EMTRACE1";
+const size_t TraceWriter::RECORD_HEADER_SIZE;
+
+namespace {
+	void put_le(char *destination, uint64_t value, size_t bytes)
+	{
+		for (size_t i = 0; i < bytes; ++i)
+			destination[i] = (char) ((value >> (8 * i)) & 0xff);
+	}
+}
+
+TraceWriter::TraceWriter(const std::string &path) :
+	recorder(path)
+{}
+
+bool TraceWriter::start()
+{
+	if (!recorder.start())
+		return false;
+
+	start_time = std::chrono::steady_clock::now();
+	recorder.record(MAGIC.data(), MAGIC.size());
+	return true;
+}
+
+void TraceWriter::stop()
+{
+	recorder.stop();
+}
+
+bool TraceWriter::write(
+	std::chrono::steady_clock::time_point time,
+	const boost::asio::ip::udp::endpoint &endpoint,
+	const char *data,
+	size_t length)
+{
+	/** The server only listens on IPv4 */
+	if (!endpoint.address().is_v4() || length > UINT16_MAX)
+		return false;
+
+	record.resize(RECORD_HEADER_SIZE + length);
+	put_le(&record[0], std::chrono::duration_cast<std::chrono::nanoseconds>(
+		time - start_time).count(), 8);
+	put_le(&record[8], endpoint.address().to_v4().to_ulong(), 4);
+	put_le(&record[12], endpoint.port(), 2);
+	put_le(&record[14], length, 2);
+	std::memcpy(&record[RECORD_HEADER_SIZE], data, length);
+
+	/** The whole record or nothing, a replay must not lose the framing */
+	return recorder.record(record.data(), record.size());
+}
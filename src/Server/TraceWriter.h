@@ -0,0 +1,48 @@
+#ifndef TRACEWRITER_H
+#define TRACEWRITER_H
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Server/Recorder.h"
+
+/**
+ * Traces every datagram the server receives, to be replayed later by the
+ * replay tool.
+ *
+ * The file starts with MAGIC, then holds one record per datagram: the time
+ * since the start in ns (64 bits), the IPv4 source address (32), its port (16)
+ * and the datagram's length (16), all little endian, followed by the bytes.
+ * The records go through a Recorder, so tracing never blocks the receiving;
+ * a record finding the ring full is dropped whole.
+ */
+class TraceWriter
+{
+public:
+	TraceWriter(const std::string &path);
+
+	/** False if the file could not be opened */
+	bool start();
+	void stop();
+
+	/** False when the datagram had to be dropped */
+	bool write(
+		std::chrono::steady_clock::time_point time,
+		const boost::asio::ip::udp::endpoint &endpoint,
+		const char *data,
+		size_t length);
+
+	static const std::string MAGIC;
+	static const size_t RECORD_HEADER_SIZE = 16;
+
+private:
+	Recorder recorder;
+	std::chrono::steady_clock::time_point start_time;
+
+	std::vector<char> record;
+};
+
+#endif // TRACEWRITER_H
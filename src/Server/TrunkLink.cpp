@@ -0,0 +1,257 @@
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <cstdio>
+#include <istream>
+
+#include "Server/TrunkLink.h"
+#include "System/Logging.h"
+#include "System/Messages.h"
+#include "System/Utils.h"
+
+/**
+ * \class TrunkLink
+ */
+
+const uint TrunkLink::RETRY_TIMEOUT_MS;
+const uint TrunkLink::KEEP_ALIVE_TIMEOUT_MS;
+const size_t TrunkLink::MAX_UPLOAD_SIZE;
+
+TrunkLink::TrunkLink(
+	boost::asio::io_service &io_service,
+	const std::string &server_name,
+	uint port,
+	size_t fifo_size,
+	size_t fifo_low_watermark,
+	size_t fifo_high_watermark) :
+
+	io_service(io_service),
+	server_name(server_name),
+	port(port),
+
+	tcp_socket(io_service),
+	udp_socket(io_service, boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), 0)),
+
+	retry_timer(io_service),
+	keep_alive_timer(io_service),
+
+	cid(0),
+	connected(false),
+	joined(false),
+
+	remote(0, fifo_size, fifo_low_watermark, fifo_high_watermark),
+
+	max_backlog(fifo_size - fifo_size % (EM::Default::CHANNELS * sizeof(EM::data_t))),
+	sent(0),
+	window(0)
+{}
+
+void TrunkLink::start()
+{
+	std::string service = boost::lexical_cast<std::string>(port);
+
+	boost::asio::ip::tcp::resolver tcp_resolver(io_service);
+	tcp_endpoint = *tcp_resolver.resolve({boost::asio::ip::tcp::v4(), server_name, service});
+	boost::asio::ip::udp::resolver udp_resolver(io_service);
+	udp_endpoint = *udp_resolver.resolve({boost::asio::ip::udp::v4(), server_name, service});
+
+	EM_WARN << "Trunking to " << tcp_endpoint << ".\n";
+
+	receive_routine();
+	connect();
+}
+
+void TrunkLink::upload(const char *data, size_t length)
+{
+	if (!connected)
+		return;
+
+	backlog.append(data, length);
+	if (backlog.size() > max_backlog)
+		backlog.erase(0, backlog.size() - max_backlog);
+	flush();
+}
+
+ClientObject &TrunkLink::get_remote()
+{
+	return remote;
+}
+
+bool TrunkLink::is_connected() const
+{
+	return connected;
+}
+
+void TrunkLink::connect()
+{
+	EM_LOG << "Trunk: connecting...\n";
+	tcp_socket.async_connect(tcp_endpoint,
+		boost::bind(&TrunkLink::handle_connect, this,
+			boost::asio::placeholders::error));
+}
+
+void TrunkLink::handle_connect(const boost::system::error_code &error)
+{
+	if (error) {
+		disconnect();
+		return;
+	}
+
+	boost::asio::async_read_until(tcp_socket, tcp_buffer, '\n',
+		boost::bind(&TrunkLink::handle_init_message, this,
+			boost::asio::placeholders::error));
+}
+
+void TrunkLink::handle_init_message(const boost::system::error_code &error)
+{
+	std::string line;
+	if (!error) {
+		std::istream stream(&tcp_buffer);
+		std::getline(stream, line);
+	}
+
+	if (error || !EM::Messages::read_client(line, cid)) {
+		disconnect();
+		return;
+	}
+
+	connected = true;
+	joined    = false;
+	sent      = 0;
+	window    = 0;
+	backlog.clear();
+	remote.reset(0);
+
+	EM_WARN << "Trunk: joined " << tcp_endpoint << " as client " << cid << ".\n";
+
+	keep_alive_routine(boost::system::error_code());
+	read_tcp();
+}
+
+void TrunkLink::read_tcp()
+{
+	/** Only the reports come this way, they just tell that the parent is alive */
+	boost::asio::async_read(tcp_socket, tcp_buffer, boost::asio::transfer_at_least(1),
+		boost::bind(&TrunkLink::handle_tcp_read, this,
+			boost::asio::placeholders::error));
+}
+
+void TrunkLink::handle_tcp_read(const boost::system::error_code &error)
+{
+	if (error == boost::asio::error::operation_aborted)
+		return;
+	if (error) {
+		disconnect();
+		return;
+	}
+
+	tcp_buffer.consume(tcp_buffer.size());
+	read_tcp();
+}
+
+void TrunkLink::disconnect()
+{
+	if (connected)
+		EM_WARN << "Trunk: lost " << tcp_endpoint << ".\n";
+	connected = false;
+	joined    = false;
+
+	boost::system::error_code error;
+	tcp_socket.close(error);
+	tcp_buffer.consume(tcp_buffer.size());
+	keep_alive_timer.cancel();
+
+	retry_timer.expires_from_now(boost::posix_time::milliseconds(RETRY_TIMEOUT_MS));
+	retry_timer.async_wait([this](const boost::system::error_code &error) {
+		if (!error)
+			connect();
+	});
+}
+
+void TrunkLink::receive_routine()
+{
+	udp_socket.async_receive_from(boost::asio::buffer(buffer), sender_endpoint,
+		boost::bind(&TrunkLink::handle_receive, this,
+			boost::asio::placeholders::error,
+			boost::asio::placeholders::bytes_transferred));
+}
+
+void TrunkLink::handle_receive(const boost::system::error_code &error, size_t length)
+{
+	if (error || !connected || sender_endpoint != udp_endpoint) {
+		receive_routine();
+		return;
+	}
+
+	std::string message(buffer.begin(), buffer.begin() + length);
+	switch (EM::Messages::get_type(message)) {
+		case EM::Messages::Type::Ack: {
+			uint ack;
+			if (EM::Messages::read_ack(message, ack, window)) {
+				joined = true;
+				flush();
+			}
+			break;
+		}
+		case EM::Messages::Type::Data: {
+			uint nr, ack;
+			size_t index = message.find('\n');
+			if (!EM::Messages::read_data(message, nr, ack, window) || index == std::string::npos)
+				break;
+			joined = true;
+
+			/** Lost DATA is not asked for again, a gap is cheaper than a late mix */
+			remote.insert_upload(message.substr(index + 1), nr);
+			flush();
+			break;
+		}
+		default:
+			break;
+	}
+
+	receive_routine();
+}
+
+void TrunkLink::keep_alive_routine(const boost::system::error_code &error)
+{
+	if (error || !connected)
+		return;
+
+	char message[EM::Messages::LENGTH];
+	if (joined)
+		std::snprintf(message, sizeof(message), "%s", EM::Messages::KeepAlive.c_str());
+	else
+		std::snprintf(message, sizeof(message), EM::Messages::Trunk.c_str(), cid);
+	send(message);
+
+	keep_alive_timer.expires_from_now(boost::posix_time::milliseconds(KEEP_ALIVE_TIMEOUT_MS));
+	keep_alive_timer.async_wait(boost::bind(&TrunkLink::keep_alive_routine, this,
+		boost::asio::placeholders::error));
+}
+
+void TrunkLink::flush()
+{
+	static const size_t FRAME_SIZE = EM::Default::CHANNELS * sizeof(EM::data_t);
+
+	while (joined && !backlog.empty()) {
+		size_t length = std::min(std::min(backlog.size(), window), MAX_UPLOAD_SIZE);
+		length -= length % FRAME_SIZE;
+		if (length == 0)
+			break;
+
+		char header[EM::Messages::LENGTH];
+		std::snprintf(header, sizeof(header), EM::Messages::Upload.c_str(), sent);
+		send(header + backlog.substr(0, length));
+
+		backlog.erase(0, length);
+		window -= length;
+		++sent;
+	}
+}
+
+void TrunkLink::send(const std::string &message)
+{
+	boost::system::error_code error;
+	udp_socket.send_to(boost::asio::buffer(message), udp_endpoint, 0, error);
+	if (error)
+		EM_LOG << "Trunk: unable to send.\n";
+}
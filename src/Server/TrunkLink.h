@@ -0,0 +1,90 @@
+#ifndef TRUNKLINK_H
+#define TRUNKLINK_H
+
+#include <boost/array.hpp>
+#include <boost/asio.hpp>
+#include <string>
+
+#include "Server/ClientObject.h"
+
+/**
+ * The uplink of a cascaded server: joins another EMServer as a trunk client,
+ * uploads the local partial mix every tick and queues the remote mix, which the
+ * parent sends without this server's own contribution.
+ *
+ * Runs on the server's io_service and reconnects on its own when the parent goes
+ * away. The remote mix is held by a ClientObject, so it gets the same FIFO and
+ * drift compensation as any local client.
+ */
+class TrunkLink
+{
+public:
+	TrunkLink(
+		boost::asio::io_service &io_service,
+		const std::string &server_name,
+		uint port,
+		size_t fifo_size,
+		size_t fifo_low_watermark,
+		size_t fifo_high_watermark);
+
+	void start();
+
+	/** The local mix of one tick, sent as the parent's window allows */
+	void upload(const char *data, size_t length);
+
+	ClientObject &get_remote();
+	bool is_connected() const;
+
+	static const uint RETRY_TIMEOUT_MS      = 1000;
+	static const uint KEEP_ALIVE_TIMEOUT_MS = 500;
+	static const size_t MAX_UPLOAD_SIZE     = 4096;
+
+private:
+	/** TCP */
+
+	void connect();
+	void handle_connect(const boost::system::error_code &error);
+	void handle_init_message(const boost::system::error_code &error);
+	void read_tcp();
+	void handle_tcp_read(const boost::system::error_code &error);
+	void disconnect();
+
+	/** UDP */
+
+	void receive_routine();
+	void handle_receive(const boost::system::error_code &error, size_t length);
+	void keep_alive_routine(const boost::system::error_code &error);
+	void flush();
+	void send(const std::string &message);
+
+	boost::asio::io_service &io_service;
+	std::string server_name;
+	uint port;
+
+	boost::asio::ip::tcp::socket tcp_socket;
+	boost::asio::ip::tcp::endpoint tcp_endpoint;
+	boost::asio::streambuf tcp_buffer;
+
+	boost::asio::ip::udp::socket udp_socket;
+	boost::asio::ip::udp::endpoint udp_endpoint;
+	boost::asio::ip::udp::endpoint sender_endpoint;
+	boost::array<char, 65536> buffer;
+
+	boost::asio::deadline_timer retry_timer;
+	boost::asio::deadline_timer keep_alive_timer;
+
+	uint cid;
+	bool connected;
+	/** Set once the parent answered, until then the handshake is repeated */
+	bool joined;
+
+	ClientObject remote;
+
+	/** Local mix not yet sent, bounded by the FIFO size */
+	std::string backlog;
+	size_t max_backlog;
+	uint sent;
+	size_t window;
+};
+
+#endif // TRUNKLINK_H
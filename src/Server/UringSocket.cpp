@@ -0,0 +1,244 @@
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Server/UringSocket.h"
+#include "System/Logging.h"
+
+/**
+ * \class UringSocket
+ */
+
+const uint UringSocket::RING_ENTRIES;
+const uint UringSocket::RECEIVE_BUFFERS;
+const uint UringSocket::RECEIVE_BUFFER_SIZE;
+const uint16_t UringSocket::BUFFER_GROUP;
+
+UringSocket::UringSocket(boost::asio::io_service &io_service, int fd) :
+	io_service(io_service),
+	fd(fd),
+
+	buffers((char *) MAP_FAILED),
+
+	descriptor(io_service)
+{
+	std::memset(&receive_header, 0, sizeof(receive_header));
+	receive_header.msg_namelen = sizeof(sockaddr_in6);
+}
+
+UringSocket::~UringSocket()
+{
+	boost::system::error_code error;
+	descriptor.close(error);
+
+	if (buffers != MAP_FAILED)
+		::munmap(buffers, RECEIVE_BUFFERS * RECEIVE_BUFFER_SIZE);
+}
+
+bool UringSocket::start(ReceiveHandler handler)
+{
+	this->handler = handler;
+
+	if (!receive_ring.init(RING_ENTRIES) || !send_ring.init(RING_ENTRIES)) {
+		EM_WARN << "No io_uring in this kernel.\n";
+		return false;
+	}
+
+	/** The provided buffers, the kernel picks one for every datagram */
+	buffers = (char *) ::mmap(nullptr, RECEIVE_BUFFERS * RECEIVE_BUFFER_SIZE,
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffers == MAP_FAILED)
+		return false;
+
+	provide(0, RECEIVE_BUFFERS);
+	io_uring_cqe *cqe = nullptr;
+	if (receive_ring.submit(1) >= 0)
+		cqe = receive_ring.peek_cqe();
+	if (cqe == nullptr || cqe->res < 0) {
+		EM_WARN << "No provided buffers in this kernel.\n";
+		return false;
+	}
+	receive_ring.seen_cqe();
+
+	/** Multishot recvmsg is rejected right away where it doesn't exist */
+	if (!arm_receive() || receive_ring.submit() < 0)
+		return false;
+	cqe = receive_ring.peek_cqe();
+	if (cqe != nullptr && cqe->res < 0) {
+		EM_WARN << "No multishot receive in this kernel.\n";
+		return false;
+	}
+
+	descriptor.assign(::dup(receive_ring.get_fd()));
+	wait_receive();
+	return true;
+}
+
+void UringSocket::send(
+	const std::vector<const std::string *> &messages,
+	const std::vector<boost::asio::ip::udp::endpoint> &endpoints,
+	std::vector<int> &results)
+{
+	size_t count = messages.size();
+	results.assign(count, -ECANCELED);
+	send_headers.resize(count);
+	send_vectors.resize(count);
+
+	for (size_t i = 0; i < count; ++i) {
+		send_vectors[i].iov_base = (void *) messages[i]->data();
+		send_vectors[i].iov_len  = messages[i]->size();
+
+		msghdr &header = send_headers[i];
+		std::memset(&header, 0, sizeof(header));
+		header.msg_name    = (void *) endpoints[i].data();
+		header.msg_namelen = endpoints[i].size();
+		header.msg_iov     = &send_vectors[i];
+		header.msg_iovlen  = 1;
+	}
+
+	/** Queued as the ring frees up; the kernel takes them in order */
+	size_t queued    = 0;
+	size_t completed = 0;
+	while (completed < count) {
+		io_uring_sqe *sqe;
+		while (queued < count && (sqe = send_ring.get_sqe()) != nullptr) {
+			sqe->opcode    = IORING_OP_SENDMSG;
+			sqe->fd        = fd;
+			sqe->addr      = (uint64_t) &send_headers[queued];
+			sqe->len       = 1;
+			sqe->user_data = queued;
+			++queued;
+		}
+
+		/** Waits for all in flight, or returns at once when some weren't taken */
+		int submitted = send_ring.submit(queued - completed);
+		size_t reaped = reap_sends(results);
+		completed += reaped;
+
+		if (submitted < 0 && reaped == 0) {
+			EM_WARN << "io_uring send failed: " << std::strerror(-submitted)
+				<< ", the rest goes by sendmsg.\n";
+			break;
+		}
+	}
+
+	if (completed == count)
+		return;
+
+	/**
+	 * None may stay in the ring, pointing at headers the next batch overwrites;
+	 * the ones taken back are the last queued
+	 */
+	queued -= send_ring.drop_unsubmitted();
+	while (completed < queued) {
+		int waited = send_ring.submit(queued - completed);
+		size_t reaped = reap_sends(results);
+		completed += reaped;
+		if (waited < 0 && reaped == 0)
+			break;
+	}
+
+	for (size_t i = queued; i < count; ++i) {
+		ssize_t sent = ::sendmsg(fd, &send_headers[i], 0);
+		results[i] = sent < 0 ? -errno : (int) sent;
+	}
+}
+
+size_t UringSocket::reap_sends(std::vector<int> &results)
+{
+	size_t reaped = 0;
+	io_uring_cqe *cqe;
+	while ((cqe = send_ring.peek_cqe()) != nullptr) {
+		/** A batch given up on may complete into the next one */
+		if (cqe->user_data < results.size())
+			results[cqe->user_data] = cqe->res;
+		send_ring.seen_cqe();
+		++reaped;
+	}
+	return reaped;
+}
+
+bool UringSocket::arm_receive()
+{
+	io_uring_sqe *sqe = receive_ring.get_sqe();
+	if (sqe == nullptr)
+		return false;
+
+	sqe->opcode    = IORING_OP_RECVMSG;
+	sqe->fd        = fd;
+	sqe->addr      = (uint64_t) &receive_header;
+	sqe->len       = 1;
+	sqe->flags     = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = BUFFER_GROUP;
+	sqe->ioprio    = IORING_RECV_MULTISHOT;
+	sqe->user_data = RECEIVE;
+	return true;
+}
+
+void UringSocket::wait_receive()
+{
+	descriptor.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+		std::bind(&UringSocket::handle_completions, this, std::placeholders::_1));
+}
+
+void UringSocket::handle_completions(const boost::system::error_code &error)
+{
+	if (error)
+		return;
+
+	bool armed = true;
+	boost::asio::ip::udp::endpoint sender;
+
+	io_uring_cqe *cqe;
+	while ((cqe = receive_ring.peek_cqe()) != nullptr) {
+		if (cqe->user_data != RECEIVE) {
+			receive_ring.seen_cqe();
+			continue;
+		}
+		if (!(cqe->flags & IORING_CQE_F_MORE))
+			armed = false;
+
+		if (cqe->res >= 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+			uint16_t buffer_id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+			char *buffer = buffers + buffer_id * RECEIVE_BUFFER_SIZE;
+
+			/** The header, then the room for the name, then the payload */
+			io_uring_recvmsg_out *out = (io_uring_recvmsg_out *) buffer;
+			char *name    = buffer + sizeof(io_uring_recvmsg_out);
+			char *payload = name + receive_header.msg_namelen + receive_header.msg_controllen;
+
+			if (!(out->flags & MSG_TRUNC) && out->namelen <= sender.capacity()) {
+				std::memcpy(sender.data(), name, out->namelen);
+				sender.resize(out->namelen);
+				handler(payload, out->payloadlen, sender);
+			}
+			provide(buffer_id, 1);
+		} else if (cqe->res < 0 && cqe->res != -ENOBUFS) {
+			EM_WARN << "io_uring receive failed: " << std::strerror(-cqe->res) << ".\n";
+		}
+
+		receive_ring.seen_cqe();
+	}
+
+	/** Stopped when the buffers ran out, they are back now */
+	if (!armed)
+		arm_receive();
+	/** The returned buffers and the new receive all go in one system call */
+	receive_ring.submit();
+	wait_receive();
+}
+
+void UringSocket::provide(uint16_t first_id, uint count)
+{
+	io_uring_sqe *sqe = receive_ring.get_sqe();
+	sqe->opcode    = IORING_OP_PROVIDE_BUFFERS;
+	sqe->fd        = count;
+	sqe->addr      = (uint64_t) (buffers + first_id * RECEIVE_BUFFER_SIZE);
+	sqe->len       = RECEIVE_BUFFER_SIZE;
+	sqe->off       = first_id;
+	sqe->buf_group = BUFFER_GROUP;
+	sqe->user_data = PROVIDE;
+}
@@ -0,0 +1,80 @@
+#ifndef URINGSOCKET_H
+#define URINGSOCKET_H
+
+#include <boost/asio.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Server/IoUring.h"
+
+/**
+ * io_uring in place of asio for the datagrams of a UDP socket.
+ *
+ * Receiving is one multishot recvmsg into a pool of provided buffers, reaped on
+ * the io_service thread when the ring's descriptor turns readable, so a flood
+ * costs no system call per datagram. Sending submits a whole batch at once and
+ * waits for it, from the one thread that sends. Each direction has its own ring,
+ * as a ring takes submissions from a single thread.
+ */
+class UringSocket
+{
+public:
+	typedef std::function<void(
+		const char *data,
+		size_t length,
+		const boost::asio::ip::udp::endpoint &sender)> ReceiveHandler;
+
+	UringSocket(boost::asio::io_service &io_service, int fd);
+	~UringSocket();
+
+	/** False when the kernel lacks what is needed, the socket is left to asio */
+	bool start(ReceiveHandler handler);
+
+	/**
+	 * Sends all the datagrams, with one system call while they fit in the ring;
+	 * results get bytes or -errno. Returns with none of them left in the ring
+	 */
+	void send(
+		const std::vector<const std::string *> &messages,
+		const std::vector<boost::asio::ip::udp::endpoint> &endpoints,
+		std::vector<int> &results);
+
+	static const uint RING_ENTRIES          = 256;
+	static const uint RECEIVE_BUFFERS       = 64;
+	static const uint RECEIVE_BUFFER_SIZE   = 65536 + 64;
+	static const uint16_t BUFFER_GROUP      = 0;
+
+private:
+	/** Queues the multishot recvmsg, submitted with the next batch */
+	bool arm_receive();
+	void wait_receive();
+	void handle_completions(const boost::system::error_code &error);
+	/** Queues buffers for the kernel to fill, submitted with the next batch */
+	void provide(uint16_t first_id, uint count);
+	/** Moves the completed sends to their results, returns how many */
+	size_t reap_sends(std::vector<int> &results);
+
+	/** Tags of the receive ring's completions */
+	enum Completion : uint64_t { RECEIVE = 1, PROVIDE = 2 };
+
+	boost::asio::io_service &io_service;
+	int fd;
+
+	IoUring receive_ring;
+	IoUring send_ring;
+
+	/** Template for the multishot recvmsg, only the name length is used */
+	msghdr receive_header;
+
+	char *buffers;
+
+	boost::asio::posix::stream_descriptor descriptor;
+	ReceiveHandler handler;
+
+	/** Kept for the send batch in flight */
+	std::vector<msghdr> send_headers;
+	std::vector<iovec> send_vectors;
+};
+
+#endif // URINGSOCKET_H
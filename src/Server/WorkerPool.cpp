@@ -0,0 +1,92 @@
+#include "Server/WorkerPool.h"
+
+/**
+ * \class WorkerPool
+ */
+
+WorkerPool::WorkerPool(size_t workers, const std::function<void(size_t)> &on_start) :
+	generation(0),
+	busy_workers(0),
+	stopping(false),
+
+	task(nullptr),
+	tasks_number(0),
+	next_task(0)
+{
+	for (size_t i = 0; i < workers; ++i)
+		this->workers.emplace_back(&WorkerPool::worker_routine, this, i, on_start);
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	start_condition.notify_all();
+
+	for (std::thread &worker : workers)
+		worker.join();
+}
+
+size_t WorkerPool::get_size() const
+{
+	return workers.size() + 1;
+}
+
+void WorkerPool::run(size_t tasks, const Task &task)
+{
+	/** Not worth a wake-up */
+	if (tasks <= 1 || workers.empty()) {
+		for (size_t i = 0; i < tasks; ++i)
+			task(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->task   = &task;
+		tasks_number = tasks;
+		next_task    = 0;
+		busy_workers = workers.size();
+		++generation;
+	}
+	start_condition.notify_all();
+
+	execute();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done_condition.wait(lock, [this]() { return busy_workers == 0; });
+	this->task = nullptr;
+}
+
+void WorkerPool::worker_routine(size_t index, std::function<void(size_t)> on_start)
+{
+	on_start(index);
+
+	uint64_t seen = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			start_condition.wait(lock, [this, seen]() {
+				return stopping || generation != seen;
+			});
+			if (stopping)
+				return;
+			seen = generation;
+		}
+
+		execute();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busy_workers == 0)
+			done_condition.notify_one();
+	}
+}
+
+void WorkerPool::execute()
+{
+	/** Whoever comes first takes the next task, a slow thread just takes fewer */
+	for (size_t i = next_task++; i < tasks_number; i = next_task++)
+		(*task)(i);
+}
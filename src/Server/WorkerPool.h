@@ -0,0 +1,54 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Splits one tick's work across a few threads: run() hands out the tasks to the
+ * workers and to the calling thread alike, and returns once all of them are done.
+ *
+ * Meant for the mixer, which calls it from one thread only. Without workers
+ * everything simply runs on the caller.
+ */
+class WorkerPool
+{
+public:
+	typedef std::function<void(size_t)> Task;
+
+	/** on_start runs first on every worker, with its index */
+	WorkerPool(size_t workers, const std::function<void(size_t)> &on_start);
+	~WorkerPool();
+
+	/** The workers plus the caller */
+	size_t get_size() const;
+
+	/** Calls task(0) ... task(tasks - 1) in no particular order, nor thread */
+	void run(size_t tasks, const Task &task);
+
+private:
+	void worker_routine(size_t index, std::function<void(size_t)> on_start);
+	void execute();
+
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable start_condition;
+	std::condition_variable done_condition;
+	/** Bumped by every run(), so a worker knows it has something new */
+	uint64_t generation;
+	size_t busy_workers;
+	bool stopping;
+
+	const Task *task;
+	size_t tasks_number;
+	std::atomic<size_t> next_task;
+};
+
+#endif // WORKERPOOL_H
@@ -1,10 +1,15 @@
 #include <boost/asio.hpp>
+#include <cerrno>
+#include <climits>
 #include <csignal>
+#include <cstdlib>
 #include <iostream>
+#include <sstream>
 
 #include "Server/EMServer.h"
 #include "System/ArgsManager.h"
 #include "System/Error.h"
+#include "System/Logging.h"
 #include "System/SignalHandler.h"
 #include "System/Strings.h"
 #include "System/Utils.h"
@@ -13,18 +18,44 @@ EMServer *em_server_ptr;
 
 void quit()
 {
-	em_server_ptr->quit();
-	std::cerr << "\nServer quitting.\n";
-	exit(EXIT_SUCCESS);
+	em_server_ptr->request_stop();
+}
+
+void report_latencies()
+{
+	em_server_ptr->request_latency_report();
+}
+
+/** Digits only, false on anything else or when it doesn't fit */
+bool read_uint(const std::string &str, uint &value)
+{
+	if (str.empty() || str.find_first_not_of("0123456789") != std::string::npos)
+		return false;
+
+	errno = 0;
+	unsigned long result = std::strtoul(str.c_str(), nullptr, 10);
+	if (errno == ERANGE || result > UINT_MAX)
+		return false;
+
+	value = (uint) result;
+	return true;
+}
+
+int invalid_arg(const std::string &value)
+{
+	std::cerr << EM::Errors::to_string(EM::Error::InvalidArg) << ": " << value << "\n";
+	return EXIT_SUCCESS;
 }
 
 int main(int argc, char **argv)
 {
 	ArgsManager args_manager(argc - 1, argv + 1);
 
-	SignalHandler::setup((int) SIGINT, quit);
-
 	EMServer em_server;
+	em_server_ptr = &em_server;
+
+	SignalHandler::setup((int) SIGINT, quit);
+	SignalHandler::setup((int) SIGUSR1, report_latencies);
 
 	while (!args_manager.finished()) {
 		switch (args_manager.get_arg()) {
@@ -49,6 +80,96 @@ int main(int argc, char **argv)
 				em_server.set_buffer_length(args_manager.get_uint());
 				break;
 
+			case EM::Arg::TxInterval:
+				em_server.set_tx_interval(args_manager.get_uint());
+				break;
+			case EM::Arg::MaxTxInterval:
+				em_server.set_max_tx_interval(args_manager.get_uint());
+				break;
+
+			case EM::Arg::MetricsPort:
+				em_server.set_metrics_port(args_manager.get_uint());
+				break;
+			case EM::Arg::MaxSpeakers:
+				em_server.set_max_speakers(args_manager.get_uint());
+				break;
+			case EM::Arg::PacketFilter:
+				em_server.set_packet_filter_level(args_manager.get_uint());
+				break;
+			case EM::Arg::IoUring:
+				em_server.set_io_uring(args_manager.get_uint() != 0);
+				break;
+			case EM::Arg::Cpus: {
+				std::stringstream list(args_manager.get_string());
+				std::vector<uint> cpus;
+				std::string cpu;
+				uint nr;
+				while (std::getline(list, cpu, ',')) {
+					if (!read_uint(cpu, nr))
+						return invalid_arg(cpu);
+					cpus.push_back(nr);
+				}
+				em_server.set_cpus(cpus);
+				break;
+			}
+			case EM::Arg::RealTimePriority:
+				em_server.set_real_time_priority(args_manager.get_uint());
+				break;
+			case EM::Arg::MixerThreads:
+				em_server.set_mixer_threads(args_manager.get_uint());
+				break;
+			case EM::Arg::Record:
+				em_server.set_record_path(args_manager.get_string());
+				break;
+			case EM::Arg::Trace:
+				em_server.set_trace_path(args_manager.get_string());
+				break;
+			case EM::Arg::Multicast: {
+				std::string multicast = args_manager.get_string();
+				size_t colon = multicast.rfind(':');
+				uint port = EM::Default::MULTICAST_PORT;
+				if (colon != std::string::npos) {
+					if (!read_uint(multicast.substr(colon + 1), port))
+						return invalid_arg(multicast);
+					multicast = multicast.substr(0, colon);
+				}
+				em_server.set_multicast(multicast, port);
+				break;
+			}
+			case EM::Arg::Source: {
+				/** A list of files, "*n" after one plays it n times */
+				std::stringstream sources(args_manager.get_string());
+				std::string source;
+				while (std::getline(sources, source, ',')) {
+					size_t star = source.rfind('*');
+					uint copies = 1;
+					if (star != std::string::npos) {
+						if (!read_uint(source.substr(star + 1), copies))
+							return invalid_arg(source);
+						source = source.substr(0, star);
+					}
+					for (uint i = 0; i < copies; ++i)
+						em_server.add_source(source);
+				}
+				break;
+			}
+			case EM::Arg::Uplink: {
+				std::string uplink = args_manager.get_string();
+				size_t colon = uplink.rfind(':');
+				uint port = EM::Default::PORT;
+				if (colon != std::string::npos) {
+					if (!read_uint(uplink.substr(colon + 1), port))
+						return invalid_arg(uplink);
+					uplink = uplink.substr(0, colon);
+				}
+				em_server.set_uplink(uplink, port);
+				break;
+			}
+
+			case EM::Arg::Verbosity:
+				EM::Logging::set_level(args_manager.get_uint());
+				break;
+
 			default:
 				std::cerr << EM::Errors::to_string(EM::Error::UnknownArg) << ": "
 				          << args_manager.get_previous_arg() << "\n";
@@ -58,5 +179,10 @@ int main(int argc, char **argv)
 
 	em_server.start();
 
-	return EXIT_SUCCESS;
+	/** Out of the signal handler, the writers' threads can be joined here */
+	em_server.quit();
+	EM::Logging::flush();
+	std::cerr << "\nServer quitting.\n";
+	/** The send and info threads never return */
+	exit(EXIT_SUCCESS);
 }
\ No newline at end of file
@@ -14,6 +14,8 @@ Connection::~Connection()
  * \class AbstractServer
  */
 
+const uint AbstractServer::SEND_INFO_TIMEOUT_MS;
+
 AbstractServer::AbstractServer() :
 	current_cid(DEFAULT_FIRST_CID)
 {}
@@ -24,4 +26,17 @@ AbstractServer::~AbstractServer()
 uint AbstractServer::get_next_cid()
 {
 	return current_cid++;
+}
+
+void AbstractServer::release_cid(uint)
+{}
+
+uint64_t AbstractServer::get_next_token()
+{
+	return 0;
+}
+
+std::string AbstractServer::get_greeting() const
+{
+	return std::string();
 }
\ No newline at end of file
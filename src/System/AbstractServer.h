@@ -1,6 +1,7 @@
 #ifndef ABSTRACT_SERVER_H
 #define ABSTRACT_SERVER_H
 
+#include <cstdint>
 #include <string>
 #include <sys/types.h>
 
@@ -19,9 +20,17 @@ public:
 	virtual ~AbstractServer();
 
 	virtual uint get_next_cid();
+	/** Gives back a cid whose connection failed before it was established */
+	virtual void release_cid(uint cid);
+	/** The secret a client resumes its session with, 0 when sessions can't be resumed */
+	virtual uint64_t get_next_token();
 	virtual void add_client(uint cid) = 0;
 	virtual void on_connection_established(uint cid, Connection *connection) = 0;
-	virtual void on_connection_lost(uint cid) = 0;
+	/** The connection tells a stale notification from one about the current client */
+	virtual void on_connection_lost(uint cid, Connection *connection) = 0;
+
+	/** Lines sent to every new connection right after its CLIENT message */
+	virtual std::string get_greeting() const;
 
 	static const uint SEND_INFO_TIMEOUT_MS = 1000;
 
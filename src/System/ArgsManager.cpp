@@ -18,6 +18,36 @@ static const std::unordered_map<std::string, EM::Arg> string_to_arg {
 	{EM::Strings::Args::FifoHighWatermark, EM::Arg::FifoHighWatermark},
 	{EM::Strings::Args::BufferLength,      EM::Arg::BufferLength},
 	{EM::Strings::Args::TxInterval,        EM::Arg::TxInterval},
+	{EM::Strings::Args::MaxTxInterval,     EM::Arg::MaxTxInterval},
+	{EM::Strings::Args::MetricsPort,       EM::Arg::MetricsPort},
+	{EM::Strings::Args::Verbosity,         EM::Arg::Verbosity},
+	{EM::Strings::Args::Json,              EM::Arg::Json},
+	{EM::Strings::Args::Duration,          EM::Arg::Duration},
+	{EM::Strings::Args::Clients,           EM::Arg::Clients},
+	{EM::Strings::Args::Rate,              EM::Arg::Rate},
+	{EM::Strings::Args::ProxyPort,         EM::Arg::ProxyPort},
+	{EM::Strings::Args::Loss,              EM::Arg::Loss},
+	{EM::Strings::Args::BurstLength,       EM::Arg::BurstLength},
+	{EM::Strings::Args::Reorder,           EM::Arg::Reorder},
+	{EM::Strings::Args::Duplicate,         EM::Arg::Duplicate},
+	{EM::Strings::Args::Delay,             EM::Arg::Delay},
+	{EM::Strings::Args::Jitter,            EM::Arg::Jitter},
+	{EM::Strings::Args::Seed,              EM::Arg::Seed},
+	{EM::Strings::Args::SampleRate,        EM::Arg::SampleRate},
+	{EM::Strings::Args::Channels,          EM::Arg::Channels},
+	{EM::Strings::Args::MaxSpeakers,       EM::Arg::MaxSpeakers},
+	{EM::Strings::Args::Uplink,            EM::Arg::Uplink},
+	{EM::Strings::Args::Record,            EM::Arg::Record},
+	{EM::Strings::Args::Source,            EM::Arg::Source},
+	{EM::Strings::Args::Multicast,         EM::Arg::Multicast},
+	{EM::Strings::Args::DirectOutput,      EM::Arg::DirectOutput},
+	{EM::Strings::Args::PacketFilter,      EM::Arg::PacketFilter},
+	{EM::Strings::Args::IoUring,           EM::Arg::IoUring},
+	{EM::Strings::Args::Cpus,              EM::Arg::Cpus},
+	{EM::Strings::Args::RealTimePriority,  EM::Arg::RealTimePriority},
+	{EM::Strings::Args::MixerThreads,      EM::Arg::MixerThreads},
+	{EM::Strings::Args::Trace,             EM::Arg::Trace},
+	{EM::Strings::Args::MaxSpeed,          EM::Arg::MaxSpeed},
 };
 
 EM::Arg EM::Args::from_string(const std::string &cmd)
@@ -65,6 +95,11 @@ uint ArgsManager::get_uint()
 	}
 }
 
+double ArgsManager::get_double()
+{
+	return std::stod(get_string());
+}
+
 std::string ArgsManager::get_string()
 {
 	if (finished()) {
@@ -21,6 +21,41 @@ namespace EM {
 		RetransmitLimit,
 
 		TxInterval,
+		MaxTxInterval,
+
+		MetricsPort,
+
+		Verbosity,
+
+		Json,
+		Duration,
+
+		Clients,
+		Rate,
+
+		ProxyPort,
+		Loss,
+		BurstLength,
+		Reorder,
+		Duplicate,
+		Delay,
+		Jitter,
+		Seed,
+		SampleRate,
+		Channels,
+		MaxSpeakers,
+		Uplink,
+		Record,
+		Source,
+		Multicast,
+		DirectOutput,
+		PacketFilter,
+		IoUring,
+		Cpus,
+		RealTimePriority,
+		MixerThreads,
+		Trace,
+		MaxSpeed,
 
 		Undefined,
 	};
@@ -36,6 +71,7 @@ public:
 
 	bool finished() const;
 	uint get_uint();
+	double get_double();
 	std::string get_string();
 	EM::Arg get_arg();
 	bool arg_set(EM::Arg arg) const;
@@ -9,6 +9,7 @@ static const std::map<EM::Error, std::string> error_to_string {
 	{EM::Error::UnknownArg,          EM::Strings::Errors::UnknownArg},
 	{EM::Error::ArgLacking,          EM::Strings::Errors::ArgLacking},
 	{EM::Error::NoServerName,        EM::Strings::Errors::NoServerName},
+	{EM::Error::NoTrace,             EM::Strings::Errors::NoTrace},
 	{EM::Error::SignalSettingFailed, EM::Strings::Errors::SignalSettingFailed},
 };
 
@@ -10,6 +10,7 @@ namespace EM {
 		UnknownArg,
 		ArgLacking,
 		NoServerName,
+		NoTrace,
 
 		SignalSettingFailed,
 	};
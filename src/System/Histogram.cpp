@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+
+#include "System/Histogram.h"
+
+/**
+ * \class Histogram
+ */
+
+Histogram::Histogram()
+{
+	for (Shard &shard : shards) {
+		for (std::atomic<uint64_t> &count : shard.counts)
+			count.store(0, std::memory_order_relaxed);
+		shard.sum.store(0, std::memory_order_relaxed);
+		shard.max.store(0, std::memory_order_relaxed);
+	}
+}
+
+void *Histogram::operator new[](size_t size)
+{
+	void *pointer;
+	if (posix_memalign(&pointer, alignof(Shard), size) != 0)
+		throw std::bad_alloc();
+	return pointer;
+}
+
+void Histogram::operator delete[](void *pointer)
+{
+	std::free(pointer);
+}
+
+Histogram::Snapshot Histogram::get_snapshot() const
+{
+	Snapshot snapshot;
+	snapshot.counts.assign(BUCKETS, 0);
+	snapshot.count = 0;
+	snapshot.sum   = 0;
+	snapshot.max   = 0;
+
+	for (const Shard &shard : shards) {
+		for (size_t i = 0; i < BUCKETS; ++i) {
+			uint64_t count = shard.counts[i].load(std::memory_order_relaxed);
+			snapshot.counts[i] += count;
+			snapshot.count     += count;
+		}
+		snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+		snapshot.max  = std::max(snapshot.max, shard.max.load(std::memory_order_relaxed));
+	}
+
+	return snapshot;
+}
+
+uint64_t Histogram::get_bucket_upper_bound(size_t index)
+{
+	if (index < SUB_BUCKETS)
+		return index;
+	size_t shift = index / SUB_BUCKETS - 1;
+	uint64_t lower = (uint64_t) (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+	return lower + ((uint64_t) 1 << shift) - 1;
+}
+
+size_t Histogram::get_shard_index()
+{
+	static std::atomic<size_t> next_shard(0);
+	static thread_local size_t shard = next_shard.fetch_add(1) % SHARDS;
+	return shard;
+}
+
+/**
+ * \class Histogram::Snapshot
+ */
+
+uint64_t Histogram::Snapshot::get_count() const
+{
+	return count;
+}
+
+uint64_t Histogram::Snapshot::get_sum() const
+{
+	return sum;
+}
+
+uint64_t Histogram::Snapshot::get_max() const
+{
+	return max;
+}
+
+uint64_t Histogram::Snapshot::get_percentile(double percentile) const
+{
+	if (count == 0)
+		return 0;
+
+	uint64_t rank = (uint64_t) std::ceil(percentile / 100.0 * count);
+	rank = std::max<uint64_t>(rank, 1);
+
+	uint64_t seen = 0;
+	for (size_t i = 0; i < counts.size(); ++i) {
+		seen += counts[i];
+		if (seen >= rank)
+			return std::min(get_bucket_upper_bound(i), max);
+	}
+	return max;
+}
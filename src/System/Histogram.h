@@ -0,0 +1,83 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Log-linear histogram of unsigned values (HDR-style, ~6% relative precision).
+ *
+ * Recording is lock-free: every thread writes to its own shard with relaxed
+ * atomics and the shards are only merged when a snapshot is taken.
+ */
+class Histogram
+{
+public:
+	Histogram();
+
+	/** The global new of C++11 doesn't honour the shards' alignment */
+	static void *operator new[](size_t size);
+	static void operator delete[](void *pointer);
+
+	void record(uint64_t value)
+	{
+		Shard &shard = shards[get_shard_index()];
+		shard.counts[get_bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+		shard.sum.fetch_add(value, std::memory_order_relaxed);
+
+		uint64_t max = shard.max.load(std::memory_order_relaxed);
+		while (value > max
+			&& !shard.max.compare_exchange_weak(max, value, std::memory_order_relaxed));
+	}
+
+	class Snapshot
+	{
+	public:
+		uint64_t get_count() const;
+		uint64_t get_sum() const;
+		uint64_t get_max() const;
+		uint64_t get_percentile(double percentile) const;
+
+	private:
+		friend class Histogram;
+
+		std::vector<uint64_t> counts;
+		uint64_t count;
+		uint64_t sum;
+		uint64_t max;
+	};
+
+	Snapshot get_snapshot() const;
+
+	static size_t get_bucket_index(uint64_t value)
+	{
+		if (value < SUB_BUCKETS)
+			return (size_t) value;
+		size_t msb = 63 - __builtin_clzll(value);
+		size_t shift = msb - SUB_BUCKET_BITS;
+		return (shift + 1) * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+	}
+
+	static uint64_t get_bucket_upper_bound(size_t index);
+
+private:
+	static const size_t SUB_BUCKET_BITS = 4;
+	static const size_t SUB_BUCKETS     = 1 << SUB_BUCKET_BITS;
+	static const size_t BUCKETS         = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+	static const size_t SHARDS          = 8;
+
+	static size_t get_shard_index();
+
+	/** Each on its own cache lines, so threads recording to their shards don't share any */
+	struct alignas(64) Shard {
+		std::atomic<uint64_t> counts[BUCKETS];
+		std::atomic<uint64_t> sum;
+		std::atomic<uint64_t> max;
+	};
+
+	Shard shards[SHARDS];
+};
+
+#endif // HISTOGRAM_H
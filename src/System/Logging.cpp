@@ -1,3 +1,180 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
 #include "System/Logging.h"
 
-EM::NullStream EM::nullstream = EM::NullStream();
\ No newline at end of file
+std::atomic<uint8_t> EM::Logging::current_level((uint8_t) EM::Logging::DEFAULT_LEVEL);
+
+namespace {
+	/**
+	 * Bounded multi-producer ring of log records, drained by one thread.
+	 *
+	 * Producers claim a slot with a CAS on the write position and publish it
+	 * through the slot sequence number; nothing on the logging side ever locks.
+	 * Records longer than a slot are truncated, records that find the ring
+	 * full are dropped and counted.
+	 */
+	class Sink
+	{
+	public:
+		Sink() :
+			write_position(0),
+			read_position(0),
+			dropped(0)
+		{
+			for (size_t i = 0; i < SLOTS; ++i)
+				slots[i].sequence.store(i, std::memory_order_relaxed);
+
+			std::thread (&Sink::drain_routine, this).detach();
+			std::atexit(EM::Logging::flush);
+		}
+
+		void push(const std::string &text)
+		{
+			size_t position = write_position.load(std::memory_order_relaxed);
+			Slot *slot;
+
+			while (true) {
+				slot = &slots[position % SLOTS];
+				size_t sequence = slot->sequence.load(std::memory_order_acquire);
+				intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+
+				if (difference == 0) {
+					if (write_position.compare_exchange_weak(position, position + 1,
+						std::memory_order_relaxed))
+						break;
+				} else if (difference < 0) {
+					dropped.fetch_add(1, std::memory_order_relaxed);
+					return;
+				} else {
+					position = write_position.load(std::memory_order_relaxed);
+				}
+			}
+
+			slot->length = std::min(text.size(), TEXT_SIZE);
+			std::memcpy(slot->text, text.data(), slot->length);
+			if (slot->length < text.size())
+				slot->text[slot->length - 1] = '\n';
+
+			slot->sequence.store(position + 1, std::memory_order_release);
+		}
+
+		void drain()
+		{
+			std::lock_guard<std::mutex> lock(drain_mutex);
+
+			std::string batch;
+			while (true) {
+				Slot &slot = slots[read_position % SLOTS];
+				if (slot.sequence.load(std::memory_order_acquire) != read_position + 1)
+					break;
+
+				batch.append(slot.text, slot.length);
+				slot.sequence.store(read_position + SLOTS, std::memory_order_release);
+				++read_position;
+
+				if (batch.size() >= BATCH_SIZE) {
+					write(batch);
+					batch.clear();
+				}
+			}
+
+			size_t dropped_records = dropped.exchange(0, std::memory_order_relaxed);
+			if (dropped_records > 0)
+				batch += "[" + std::to_string(dropped_records) + " log records dropped]\n";
+
+			write(batch);
+		}
+
+	private:
+		static const size_t SLOTS      = 1024;
+		static const size_t TEXT_SIZE  = 1024 - 2 * sizeof(size_t);
+		static const size_t BATCH_SIZE = 65536;
+		static const uint   DRAIN_INTERVAL_MS = 1;
+
+		struct Slot {
+			std::atomic<size_t> sequence;
+			size_t length;
+			char text[TEXT_SIZE];
+		};
+
+		void drain_routine()
+		{
+			pthread_setname_np(pthread_self(), "em-log");
+			while (true) {
+				drain();
+				std::this_thread::sleep_for(std::chrono::milliseconds(DRAIN_INTERVAL_MS));
+			}
+		}
+
+		static void write(const std::string &batch)
+		{
+			size_t written = 0;
+			while (written < batch.size()) {
+				ssize_t result = ::write(STDERR_FILENO, batch.data() + written,
+					batch.size() - written);
+				if (result <= 0)
+					return;
+				written += result;
+			}
+		}
+
+		/** Producers and the consumer keep their positions on separate cache lines */
+		std::atomic<size_t> write_position;
+		char padding[64];
+		size_t read_position;
+		std::atomic<size_t> dropped;
+		std::mutex drain_mutex;
+
+		Slot slots[SLOTS];
+	};
+
+	const size_t Sink::TEXT_SIZE;
+	const uint Sink::DRAIN_INTERVAL_MS;
+
+	Sink &get_sink()
+	{
+		/** Never destroyed, the drain thread may outlive static destruction */
+		static Sink *sink = new Sink();
+		return *sink;
+	}
+}
+
+void EM::Logging::set_level(uint level)
+{
+	current_level.store(std::min<uint>(level, (uint) Level::Debug), std::memory_order_relaxed);
+}
+
+EM::Logging::Level EM::Logging::get_level()
+{
+	return (Level) current_level.load(std::memory_order_relaxed);
+}
+
+void EM::Logging::flush()
+{
+	get_sink().drain();
+}
+
+/**
+ * \class EM::Logging::Record
+ */
+
+EM::Logging::Record::Record()
+{}
+
+EM::Logging::Record::~Record()
+{
+	get_sink().push(ss.str());
+}
+
+std::ostream &EM::Logging::Record::stream()
+{
+	return ss;
+}
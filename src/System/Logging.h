@@ -1,98 +1,93 @@
 #ifndef LOGGING_H
 #define LOGGING_H
 
-#include <iostream>
+#include <atomic>
+#include <cstdint>
+#include <sstream>
 
-#define PRINT_LEVEL 3
+/**
+ * Logging macros, used as streams:
+ *
+ *     EM_LOG << "READ " << message << "\n";
+ *
+ * When the level is disabled nothing right of the macro is evaluated.
+ * Enabled records are queued in a lock-free ring and written to stderr
+ * by a background thread, so the callers never block on the terminal.
+ */
+#define EM_LOG_AT(level) \
+	!EM::Logging::is_enabled(level) ? (void) 0 : \
+		EM::Logging::Voidify() & EM::Logging::Record().stream()
 
 /**
  * For printing debug messages - enabled for developing only.
  */
-#if PRINT_LEVEL >= 5
-#define PRINT_DEBUG
-#endif
+#define EM_DEBUG EM_LOG_AT(EM::Logging::Level::Debug)
 
 /**
  * Tons of messages concerning sending and receiving.
  */
-#if PRINT_LEVEL >= 4
-#define PRINT_LOG
-#endif
+#define EM_LOG EM_LOG_AT(EM::Logging::Level::Log)
 
 /**
  * Information about state changes.
  */
-#if PRINT_LEVEL >= 3
-#define PRINT_INFO
-#endif
+#define EM_INFO EM_LOG_AT(EM::Logging::Level::Info)
 
 /**
  * When something went wrong.
  */
-#if PRINT_LEVEL >= 2
-#define PRINT_WARNING
-#endif
+#define EM_WARN EM_LOG_AT(EM::Logging::Level::Warning)
 
 /**
  * When something dangerous happened and this is all about this program when it happens.
  */
-#if PRINT_LEVEL >= 1
-#define PRINT_ERROR
-#endif
+#define EM_ERROR EM_LOG_AT(EM::Logging::Level::Error)
 
 namespace EM {
-	class NullStream : public std::ostream {
-	public:
-		NullStream() : std::ios(0), std::ostream(0) {}
-		NullStream(NullStream &&) : std::ios(0), std::ostream(0) {}
-	};
+	namespace Logging {
+		enum class Level : uint8_t {
+			None,
+			Error,
+			Warning,
+			Info,
+			Log,
+			Debug,
+		};
 
-	extern NullStream nullstream;
-}
+		static const Level DEFAULT_LEVEL = Level::Info;
 
-inline std::ostream &debug()
-{
-#ifdef PRINT_DEBUG
-	return std::cerr;
-#else
-	return EM::nullstream;
-#endif
-}
+		extern std::atomic<uint8_t> current_level;
 
-inline std::ostream &log()
-{
-#ifdef PRINT_LOG
-	return std::cerr;
-#else
-	return EM::nullstream;
-#endif
-}
+		inline bool is_enabled(Level level)
+		{
+			return (uint8_t) level <= current_level.load(std::memory_order_relaxed);
+		}
 
-inline std::ostream &info()
-{
-#ifdef PRINT_INFO
-	return std::cerr;
-#else
-	return EM::nullstream;
-#endif
-}
+		void set_level(uint level);
+		Level get_level();
 
-inline std::ostream &warn()
-{
-#ifdef PRINT_WARNING
-	return std::cerr;
-#else
-	return EM::nullstream;
-#endif
-}
+		/** Writes out everything queued so far, called before exiting */
+		void flush();
+
+		/** Lets the logging macros be a single expression of type void */
+		struct Voidify {
+			void operator&(std::ostream &) {}
+		};
+
+		class Record
+		{
+		public:
+			Record();
+			~Record();
+
+			std::ostream &stream();
+
+		private:
+			Record(const Record &) = delete;
 
-inline std::ostream &error()
-{
-#ifdef PRINT_ERROR
-	return std::cerr;
-#else
-	return EM::nullstream;
-#endif
+			std::ostringstream ss;
+		};
+	}
 }
 
-#endif // LOGGING_H
\ No newline at end of file
+#endif // LOGGING_H
@@ -1,4 +1,7 @@
+#include <cstdio>
+
 #include "System/Messages.h"
+#include "System/Utils.h"
 
 EM::Messages::Type EM::Messages::get_type(const std::string &str)
 {
@@ -31,6 +34,56 @@ bool EM::Messages::read_client(const std::string &str, uint &nr)
 	return !ss.bad();
 }
 
+bool EM::Messages::read_client(const std::string &message, uint &nr, uint64_t &token)
+{
+	std::string s;
+	std::stringstream ss(message);
+
+	ss >> s;
+	if (s != Headers::Client)
+		return false;
+
+	ss >> nr;
+	if (ss.fail())
+		return false;
+
+	if (!(ss >> std::hex >> token))
+		token = 0;
+
+	return true;
+}
+
+bool EM::Messages::read_client(
+	const std::string &message,
+	uint &nr,
+	uint &rate,
+	uint &channels,
+	bool &multicast)
+{
+	std::string s;
+	std::stringstream ss(message);
+
+	ss >> s;
+	if (s != Headers::Client)
+		return false;
+
+	ss >> nr;
+	if (ss.fail())
+		return false;
+
+	/** Only the fields missing are defaulted, a rate alone is kept */
+	if (!(ss >> rate))
+		rate = EM::Default::SAMPLE_RATE;
+	if (!(ss >> channels))
+		channels = EM::Default::CHANNELS;
+
+	uint flag;
+	multicast = (ss >> flag) && flag != 0;
+
+	return rate >= MIN_SAMPLE_RATE && rate <= MAX_SAMPLE_RATE
+		&& channels >= 1 && channels <= MAX_CHANNELS;
+}
+
 
 bool EM::Messages::read_data(const std::string &message, uint &nr, uint &ack, size_t &win)
 {
@@ -46,6 +99,30 @@ bool EM::Messages::read_data(const std::string &message, uint &nr, uint &ack, si
 	return !ss.bad();
 }
 
+bool EM::Messages::read_data(
+	const std::string &message,
+	uint &nr,
+	uint &ack,
+	size_t &win,
+	uint &interval)
+{
+	std::string s;
+	std::stringstream ss(message);
+
+	ss >> s;
+	if (s != Headers::Data)
+		return false;
+
+	ss >> nr >> ack >> win;
+	if (ss.fail())
+		return false;
+
+	if (!(ss >> interval))
+		interval = 0;
+
+	return true;
+}
+
 bool EM::Messages::read_ack(const std::string &message, uint &ack, size_t &win)
 {
 	std::string s;
@@ -80,10 +157,78 @@ bool EM::Messages::read_retransmit(const std::string &message, uint &nr)
 	std::stringstream ss(message);
 
 	ss >> s;
-	if (s != Headers::Upload)
+	if (s != Headers::Retransmit)
 		return false;
 
 	ss >> nr;
 
 	return !ss.bad();
 }
+
+bool EM::Messages::read_trunk(const std::string &message, uint &cid)
+{
+	std::string s;
+	std::stringstream ss(message);
+
+	ss >> s;
+	if (s != Headers::Trunk)
+		return false;
+
+	ss >> cid;
+
+	return !ss.fail();
+}
+
+bool EM::Messages::read_multicast(const std::string &message, std::string &group, uint &port)
+{
+	std::string s;
+	std::stringstream ss(message);
+
+	ss >> s;
+	if (s != Headers::Multicast)
+		return false;
+
+	ss >> group >> port;
+
+	return !ss.fail();
+}
+
+bool EM::Messages::read_resume(
+	const std::string &message,
+	uint &cid,
+	uint64_t &token,
+	uint &connection_cid,
+	uint64_t &connection_token)
+{
+	std::string s;
+	std::stringstream ss(message);
+
+	ss >> s;
+	if (s != Headers::Resume)
+		return false;
+
+	ss >> cid >> std::hex >> token >> std::dec;
+	if (ss.fail())
+		return false;
+
+	if (!(ss >> connection_cid))
+		connection_cid = 0;
+	if (connection_cid == 0 || !(ss >> std::hex >> connection_token))
+		connection_token = 0;
+
+	return token != 0;
+}
+
+std::string EM::Messages::write_data(uint nr, uint ack, size_t win, uint interval)
+{
+	char header[LENGTH];
+	int length = std::snprintf(header, LENGTH, Data.c_str(), nr, ack, (uint) win, interval);
+	return std::string(header, length);
+}
+
+std::string EM::Messages::write_ack(uint ack, size_t win)
+{
+	char header[LENGTH];
+	int length = std::snprintf(header, LENGTH, Ack.c_str(), ack, (uint) win);
+	return std::string(header, length);
+}
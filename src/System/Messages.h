@@ -2,6 +2,7 @@
 #define MESSAGES_H
 
 #include <cctype>
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -16,15 +17,23 @@ namespace EM {
 			const std::string Ack        = "ACK";
 			const std::string Retransmit = "RETRANSMIT";
 			const std::string KeepAlive  = "KEEPALIVE";
+			const std::string Trunk      = "TRUNK";
+			const std::string Multicast  = "MULTICAST";
+			const std::string Resume     = "RESUME";
 		}
 
 		const std::string Client     = Headers::Client + " %u\n";
+		const std::string ClientSession = Headers::Client + " %u %016llx\n";
+		const std::string ClientFormat = Headers::Client + " %u %u %u %u\n";
 		const std::string List       = "%s FIFO: %u/%u (min. %u, max. %u)\n";
 		const std::string Upload     = Headers::Upload + " %u\n";
-		const std::string Data       = Headers::Data + " %u %u %u\n";
+		const std::string Data       = Headers::Data + " %u %u %u %u\n";
 		const std::string Ack        = Headers::Ack + " %u %u\n";
 		const std::string Retransmit = Headers::Retransmit + " %u\n";
 		const std::string KeepAlive  = Headers::KeepAlive + "\n";
+		const std::string Trunk      = Headers::Trunk + " %u\n";
+		const std::string Multicast  = Headers::Multicast + " %s %u\n";
+		const std::string Resume     = Headers::Resume + " %u %016llx %u %016llx\n";
 
 		enum class Type : uint8_t {
 			Client,
@@ -34,6 +43,9 @@ namespace EM {
 			Ack,
 			Retransmit,
 			KeepAlive,
+			Trunk,
+			Multicast,
+			Resume,
 			Unknown,
 		};
 
@@ -44,26 +56,77 @@ namespace EM {
 			{Headers::Ack,        Type::Ack},
 			{Headers::Retransmit, Type::Retransmit},
 			{Headers::KeepAlive,  Type::KeepAlive},
+			{Headers::Trunk,      Type::Trunk},
+			{Headers::Multicast,  Type::Multicast},
+			{Headers::Resume,     Type::Resume},
 		};
 
 		const size_t LENGTH = 128;
 
+		const uint MIN_SAMPLE_RATE = 8000;
+		const uint MAX_SAMPLE_RATE = 192000;
+		const uint MAX_CHANNELS    = 8;
+
 		Type get_type(const std::string &str);
 		Type get_type(const char *str, size_t length);
 
 		bool read_client(const std::string &message, uint &nr);
 
+		/** The TCP greeting, token is 0 from servers that don't resume sessions */
+		bool read_client(const std::string &message, uint &nr, uint64_t &token);
+
+		/**
+		 * Rate, channels and the multicast flag are optional, older clients don't
+		 * send them
+		 */
+		bool read_client(
+			const std::string &message,
+			uint &nr,
+			uint &rate,
+			uint &channels,
+			bool &multicast);
+
 		bool read_data(
 			const std::string &message,
 			uint &nr,
 			uint &ack,
 			size_t &win);
 
+		/** Also the length of the frame in ms, 0 from servers that don't tell it */
+		bool read_data(
+			const std::string &message,
+			uint &nr,
+			uint &ack,
+			size_t &win,
+			uint &interval);
+
 		bool read_ack(const std::string &message, uint &ack, size_t &win);
 
 		bool read_upload(const std::string &message, uint &nr);
 
 		bool read_retransmit(const std::string &message, uint &nr);
+
+		/** A server joining another one as a client, in place of the UDP CLIENT */
+		bool read_trunk(const std::string &message, uint &cid);
+
+		/** The group the mix is sent to, announced over TCP after CLIENT */
+		bool read_multicast(const std::string &message, std::string &group, uint &port);
+
+		/**
+		 * A client back on its session, maybe from a new address; connection_cid
+		 * names the new TCP connection to take over, 0 keeps the current one, and
+		 * connection_token proves it is the client's own
+		 */
+		bool read_resume(
+			const std::string &message,
+			uint &cid,
+			uint64_t &token,
+			uint &connection_cid,
+			uint64_t &connection_token);
+
+		std::string write_data(uint nr, uint ack, size_t win, uint interval);
+
+		std::string write_ack(uint ack, size_t win);
 	}
 }
 
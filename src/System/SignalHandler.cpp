@@ -8,7 +8,7 @@ std::map<int, std::function<void(void)> > SignalHandler::exit_functions;
 
 void SignalHandler::setup(int signal_number, std::function<void(void)> exit_function)
 {
-	if (std::signal((int) SIGINT, handle) == SIG_ERR) {
+	if (std::signal(signal_number, handle) == SIG_ERR) {
 		std::cerr << EM::Errors::to_string(EM::Error::SignalSettingFailed) << "\n";
 		exit(EXIT_SUCCESS);
 	}
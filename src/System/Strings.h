@@ -14,6 +14,36 @@ namespace EM {
 			const std::string FifoHighWatermark = "-H";
 			const std::string BufferLength      = "-X";
 			const std::string TxInterval        = "-i";
+			const std::string MaxTxInterval     = "-T";
+			const std::string MetricsPort       = "-m";
+			const std::string Verbosity         = "-v";
+			const std::string Json              = "-j";
+			const std::string Duration          = "-t";
+			const std::string Clients           = "-n";
+			const std::string Rate              = "-r";
+			const std::string ProxyPort         = "-P";
+			const std::string Loss              = "-l";
+			const std::string BurstLength       = "-b";
+			const std::string Reorder           = "-o";
+			const std::string Duplicate         = "-u";
+			const std::string Delay             = "-d";
+			const std::string Jitter            = "-J";
+			const std::string Seed              = "-S";
+			const std::string SampleRate        = "-R";
+			const std::string Channels          = "-C";
+			const std::string MaxSpeakers       = "-k";
+			const std::string Uplink            = "-U";
+			const std::string Record            = "-w";
+			const std::string Source            = "-a";
+			const std::string Multicast         = "-M";
+			const std::string DirectOutput      = "-O";
+			const std::string PacketFilter      = "-K";
+			const std::string IoUring           = "-I";
+			const std::string Cpus              = "-c";
+			const std::string RealTimePriority  = "-f";
+			const std::string MixerThreads      = "-W";
+			const std::string Trace             = "-D";
+			const std::string MaxSpeed          = "-x";
 		}
 
 		const std::string Error = "Error";
@@ -26,6 +56,9 @@ namespace EM {
 			const std::string NoServerName    =
 				std::string("No server name given (use ") + Args::ServerName
 				+ std::string(")");
+			const std::string NoTrace         =
+				std::string("No trace given (use ") + Args::Trace
+				+ std::string(")");
 
 			const std::string SignalSettingFailed = "Signal setting failed";
 		}
@@ -40,7 +73,24 @@ namespace EM {
 				std::string("  -L             FIFO low watermark\n") +
 				std::string("  -H             FIFO high watermark\n") +
 				std::string("  -X             buffer length\n") +
-				std::string("  -i             tx interval\n");
+				std::string("  -i             tx interval in ms (default 5), the shortest with -T\n") +
+				std::string("  -T             let the tx interval grow with the load up to this (ms)\n") +
+				std::string("  -m             metrics port (Prometheus, 127.0.0.1 only)\n") +
+				std::string("  -k             mix only the k loudest clients (default 0, all)\n") +
+				std::string("  -U             join another server as a trunk (host[:port])\n") +
+				std::string("  -w             record the mix to a file (.wav or raw)\n") +
+				std::string("  -D             trace the received datagrams to a file, see ./replay\n") +
+				std::string("  -M             send the mix to a multicast group (group[:port])\n") +
+				std::string("  -K             kernel packet filter (0 off, 1 headers, 2 and hosts)\n") +
+				std::string("  -I             UDP through io_uring (0 asio, 1 io_uring)\n") +
+				std::string("  -c             pin the mixer, send, info and -W threads (cores, a,b,c)\n") +
+				std::string("  -f             SCHED_FIFO priority of the mixer (default 0, off)\n") +
+				std::string("  -W             threads helping the mixer (default 0), only worth it on\n") +
+				std::string("                 multi-core hosts for rooms of 150 clients or more\n") +
+				std::string("  -a             play files in the meeting (.wav or raw, a,b*n)\n") +
+				std::string("  -v             log level (0 none ... 5 debug, default 3)\n") +
+				std::string("\n") +
+				std::string("SIGUSR1 prints the latency percentiles to stderr.\n");
 		}
 
 		namespace Client {
@@ -50,7 +100,74 @@ namespace EM {
 				std::string("\n") +
 				std::string("  -p             port number (optional)\n") +
 				std::string("  -s             server name\n") +
-				std::string("  -X             retransmit limit\n");
+				std::string("  -X             retransmit limit\n") +
+				std::string("  -R             sample rate of the input (default 44100)\n") +
+				std::string("  -C             channels of the input (default 2)\n") +
+				std::string("  -O             write the mix straight to the stdout descriptor\n") +
+				std::string("  -v             log level (0 none ... 5 debug, default 3)\n");
+		}
+
+		namespace Benchmark {
+			const std::string HelpMessage =
+				std::string("Usage: ./benchmark [OPTION]...\n") +
+				std::string("Runs the E-Meeting microbenchmarks\n") +
+				std::string("\n") +
+				std::string("  -j             JSON output\n") +
+				std::string("  -t             minimal time per benchmark in ms\n");
+		}
+
+		namespace LoadGen {
+			const std::string HelpMessage =
+				std::string("Usage: ./loadgen [OPTION]...\n") +
+				std::string("Simulates many clients of an E-Meeting server\n") +
+				std::string("\n") +
+				std::string("  -p             port number (optional)\n") +
+				std::string("  -s             server name\n") +
+				std::string("  -n             number of clients (default 100)\n") +
+				std::string("  -r             upload rate per client in B/s (default 176400)\n") +
+				std::string("  -t             duration in seconds, 0 runs until SIGINT (default 10)\n") +
+				std::string("  -X             retransmit limit\n") +
+				std::string("  -v             log level (0 none ... 5 debug, default 3)\n");
+		}
+
+		namespace Replay {
+			const std::string HelpMessage =
+				std::string("Usage: ./replay [OPTION]...\n") +
+				std::string("Feeds a datagram trace of ./server -D through the server's mixer\n") +
+				std::string("\n") +
+				std::string("  -D             trace file\n") +
+				std::string("  -x             as fast as possible instead of in real time\n") +
+				std::string("  -F             FIFO size\n") +
+				std::string("  -L             FIFO low watermark\n") +
+				std::string("  -H             FIFO high watermark\n") +
+				std::string("  -X             buffer length\n") +
+				std::string("  -i             tx interval in ms (default 5), the shortest with -T\n") +
+				std::string("  -T             let the tx interval grow with the load up to this (ms)\n") +
+				std::string("  -k             mix only the k loudest clients (default 0, all)\n") +
+				std::string("  -W             threads helping the mixer (default 0), only worth it on\n") +
+				std::string("                 multi-core hosts for rooms of 150 clients or more\n") +
+				std::string("  -w             record the mix to a file (.wav or raw)\n") +
+				std::string("  -v             log level (0 none ... 5 debug, default 3)\n") +
+				std::string("\n") +
+				std::string("The latency percentiles are printed to stderr at the end.\n");
+		}
+
+		namespace Proxy {
+			const std::string HelpMessage =
+				std::string("Usage: ./proxy [OPTION]...\n") +
+				std::string("Relays E-Meeting traffic, impairing the UDP datagrams\n") +
+				std::string("\n") +
+				std::string("  -s             server name\n") +
+				std::string("  -p             server port (optional)\n") +
+				std::string("  -P             port to listen on (optional)\n") +
+				std::string("  -l             loss in %, burst start probability with -b\n") +
+				std::string("  -b             mean burst loss length in datagrams\n") +
+				std::string("  -o             reordering in %\n") +
+				std::string("  -u             duplication in %\n") +
+				std::string("  -d             delay in ms\n") +
+				std::string("  -J             jitter in ms (uniform, added to the delay)\n") +
+				std::string("  -S             random seed\n") +
+				std::string("  -v             log level (0 none ... 5 debug, default 3)\n");
 		}
 	}
 }
@@ -22,9 +22,30 @@ namespace EM {
 
 		static const uint BUFFER_LENGTH    = 10;
 
-		static const uint TX_INTERVAL = 5;
+		static const uint TX_INTERVAL     = 5;
+		static const uint MAX_TX_INTERVAL = 0;
+
+		static const uint MAX_SPEAKERS = 0;
+
+		static const uint SAMPLE_RATE = 44100;
+		static const uint CHANNELS    = 2;
 
 		const uint RETRANSMIT_LIMIT = 10;
+
+		static const uint LOADGEN_CLIENTS  = 100;
+		static const uint LOADGEN_RATE     = 176400;
+		static const uint LOADGEN_DURATION = 10;
+
+		static const uint PROXY_PORT = PORT + 1;
+		static const uint PROXY_SEED = 1;
+
+		static const uint MULTICAST_PORT = PORT + 2;
+		static const uint MULTICAST_HOPS = 1;
+
+		static const uint PACKET_FILTER_LEVEL = 1;
+
+		static const uint REAL_TIME_PRIORITY = 0;
+		static const uint MIXER_THREADS      = 0;
 	}
 }
 
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "Server/ClientObject.h"
+#include "Server/EMServer.h"
+#include "Server/Mixer.h"
+
+static const size_t DATA_LENGTH = 1760;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what)
+{
+	if (!condition) {
+		std::cerr << "FAILED: " << what << "\n";
+		++failures;
+	}
+}
+
+/** Clients with the given energies, the trunk ones flagged */
+static std::vector<std::unique_ptr<ClientObject> > make_clients(
+	const std::vector<uint64_t> &energies,
+	const std::vector<bool> &trunks)
+{
+	std::vector<std::unique_ptr<ClientObject> > clients;
+	for (size_t i = 0; i < energies.size(); ++i) {
+		clients.emplace_back(new ClientObject(i + 1, 4 * DATA_LENGTH, 0, 0));
+		/** One update over the smoothing sets the energy outright */
+		clients.back()->update_energy(energies[i] * ClientObject::ENERGY_SMOOTHING);
+		clients.back()->set_trunk(trunks[i]);
+	}
+	return clients;
+}
+
+static size_t select(std::vector<std::unique_ptr<ClientObject> > &clients, size_t max_speakers,
+	std::vector<ClientObject *> &active, std::vector<Mixer::MixerInput> &inputs)
+{
+	active.clear();
+	inputs.assign(clients.size(), Mixer::MixerInput{nullptr, DATA_LENGTH, 0});
+	for (std::unique_ptr<ClientObject> &client : clients)
+		active.push_back(client.get());
+	return EMServer::select_speakers(active.data(), inputs.data(), active.size(),
+		DATA_LENGTH, max_speakers);
+}
+
+static bool is_mixed(const std::vector<ClientObject *> &active, size_t mixed, uint cid)
+{
+	for (size_t i = 0; i < mixed; ++i)
+		if (active[i]->get_cid() == cid)
+			return true;
+	return false;
+}
+
+/** A quiet trunk is mixed, on top of the max_speakers loudest clients */
+static void test_quiet_trunk_is_mixed()
+{
+	std::vector<std::unique_ptr<ClientObject> > clients =
+		make_clients({500, 10, 400, 1, 300}, {false, false, false, true, false});
+	std::vector<ClientObject *> active;
+	std::vector<Mixer::MixerInput> inputs;
+
+	size_t mixed = select(clients, 2, active, inputs);
+
+	check(mixed == 3, "two speakers and the trunk are mixed");
+	check(is_mixed(active, mixed, 4), "the quiet trunk is mixed");
+	check(is_mixed(active, mixed, 1) && is_mixed(active, mixed, 3), "the loudest two are mixed");
+	check(!is_mixed(active, mixed, 2) && !is_mixed(active, mixed, 5), "the others are not");
+	for (size_t i = mixed; i < active.size(); ++i)
+		check(inputs[i].consumed == DATA_LENGTH, "the unmixed inputs are drained");
+}
+
+/** Trunks alone fill no speaker slot */
+static void test_trunks_over_the_cap()
+{
+	std::vector<std::unique_ptr<ClientObject> > clients =
+		make_clients({1, 2, 900}, {true, true, false});
+	std::vector<ClientObject *> active;
+	std::vector<Mixer::MixerInput> inputs;
+
+	size_t mixed = select(clients, 1, active, inputs);
+
+	check(mixed == 3, "both trunks and the speaker are mixed");
+}
+
+int main()
+{
+	test_quiet_trunk_is_mixed();
+	test_trunks_over_the_cap();
+
+	if (failures == 0)
+		std::cout << "All passed.\n";
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}